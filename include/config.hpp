@@ -1,5 +1,6 @@
 #pragma once
 
+#include <map>
 #include <string>
 #include <switch.h>
 
@@ -8,6 +9,9 @@ typedef struct {
     bool dev_options = false;
     bool image_filename = false;
     bool multi_lang = false;
+    bool natural_sort = false;
+    int verify_copies = 0;
+    std::map<std::string, u32> copy_block_sizes;
 } config_t;
 
 extern config_t cfg;
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <string>
+#include <switch.h>
+
+#include "fs.hpp"
+
+namespace DirList {
+    bool Start(const std::string &device, const std::string &path, DirListing &entries);
+    bool Poll(DirListing &entries, std::size_t &offset);
+    bool UpdateMetadata(DirListing &entries);
+    bool Revalidate(DirListing &entries);
+    bool Modify(DirListing &entries);
+    void EntryAdded(const DirEntry &entry);
+    void EntryRemoved(const DirEntry &entry);
+    bool Busy(void);
+    void Cancel(void);
+    void Invalidate(const std::string &path);
+    void ClearCache(void);
+}
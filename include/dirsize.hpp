@@ -0,0 +1,18 @@
+#pragma once
+
+#include <string>
+#include <switch.h>
+
+typedef struct {
+    s64 size = 0;
+    u64 files = 0;
+    u64 folders = 0;
+    bool done = false;
+} DirSizeResult;
+
+namespace DirSize {
+    void Start(const std::string &device, const std::string &path);
+    void Get(DirSizeResult &result);
+    void Cancel(void);
+    void Invalidate(const std::string &path);
+}
@@ -1,6 +1,10 @@
 #pragma once
 
+#include <dirent.h>
+#include <ctime>
+#include <memory>
 #include <string>
+#include <string_view>
 #include <switch.h>
 #include <vector>
 
@@ -19,6 +23,89 @@ typedef enum FileSystemDevices {
     FileSystemMax
 } FileSystemDevices;
 
+typedef enum DirEntryFlags {
+    DirEntryFlagNone = 0,
+    DirEntryFlagParent = BIT(0),
+    DirEntryFlagSize = BIT(1),
+    DirEntryFlagTime = BIT(2)
+} DirEntryFlags;
+
+// Compact replacement for FsDirectoryEntry, the name lives in the string blocks of the owning DirListing.
+// The id is unique within a listing and doesn't change when it's sorted, so background results can find their entry.
+// A case-folded copy of the name is stored right after it, see DirListing::GetKey(). file_type doubles as the icon index.
+typedef struct {
+    const char *name = nullptr;
+    s64 file_size = 0;
+    time_t modified = 0;
+    u32 id = 0;
+    u16 name_length = 0;
+    u8 type = FsDirEntryType_File;
+    u8 flags = DirEntryFlagNone;
+    u8 file_type = FileTypeNone;
+} DirEntry;
+
+class DirListing {
+public:
+    DirEntry &operator[](std::size_t index) { return entries[index]; }
+    const DirEntry &operator[](std::size_t index) const { return entries[index]; }
+    std::vector<DirEntry>::iterator begin(void) { return entries.begin(); }
+    std::vector<DirEntry>::iterator end(void) { return entries.end(); }
+    std::vector<DirEntry>::const_iterator begin(void) const { return entries.begin(); }
+    std::vector<DirEntry>::const_iterator end(void) const { return entries.end(); }
+    std::size_t size(void) const { return entries.size(); }
+    bool empty(void) const { return entries.empty(); }
+
+    DirEntry &Add(const char *name, u8 type, s64 file_size);
+    DirEntry &AddParent(void);
+    void Append(DirListing &other);
+    void Permute(const std::vector<u32> &order);
+    void Remove(std::size_t index);
+    void clear(void);
+    std::size_t GetMemoryUsage(void) const;
+
+    // Collation key computed once when the entry is added, so sorting never has to fold case itself.
+    static const char *GetKey(const DirEntry &entry) { return entry.name + entry.name_length + 1; }
+
+    // Changes whenever entries are added, removed or reordered, so views over the listing know to rebuild.
+    u64 GetRevision(void) const { return revision; }
+
+private:
+    // Names are packed into fixed size blocks that never move, so the name pointers stay
+    // valid when the listing is sorted, moved around or appended to another one.
+    static constexpr std::size_t block_size = 0x1000;
+
+    std::vector<DirEntry> entries;
+    std::vector<std::unique_ptr<char[]>> blocks;
+    std::size_t block_offset = block_size;
+    u32 next_id = 0;
+    u64 revision = 0;
+
+    void Touch(void);
+};
+
+// One buffer for a whole traversal: a name is pushed going into a folder and popped coming back out,
+// so recursive operations don't build a new string for every file.
+class PathBuilder {
+public:
+    explicit PathBuilder(std::string_view base);
+
+    std::size_t Push(std::string_view name);
+    void Pop(std::size_t length) { path.resize(length); }
+    const char *c_str(void) const { return path.c_str(); }
+    std::string_view view(void) const { return path; }
+
+private:
+    std::string path;
+};
+
+// Reads a folder through fsDirRead when we have the device's FsFileSystem, readdir() otherwise (USB drives).
+typedef struct {
+    FsDir fs_dir;
+    DIR *dir = nullptr;
+    bool native = false;
+    std::unique_ptr<FsDirectoryEntry[]> buffer;
+} DirReader;
+
 extern FsFileSystem *fs;
 extern FsFileSystem devices[FileSystemMax];
 
@@ -26,21 +113,27 @@ namespace FS {
     bool FileExists(const std::string &path);
     bool DirExists(const std::string &path);
     bool GetFileSize(const std::string &path, std::size_t &size);
-    bool GetDirList(const std::string &device, const std::string &path, std::vector<FsDirectoryEntry> &entries);
-    bool ChangeDirNext(const std::string &path, std::vector<FsDirectoryEntry> &entries);
-    bool ChangeDirPrev(std::vector<FsDirectoryEntry> &entries);
-    bool GetTimeStamp(FsDirectoryEntry &entry, FsTimeStampRaw &timestamp);
-    bool Rename(FsDirectoryEntry &entry, const std::string &dest_path);
-    bool Delete(FsDirectoryEntry &entry);
-    void Copy(FsDirectoryEntry &entry, const std::string &path);
+    FsFileSystem *GetFileSystem(const std::string &device);
+    bool OpenDir(const std::string &device, const std::string &path, DirReader &reader);
+    std::size_t ReadDir(DirReader &reader, DirListing &entries, std::size_t max);
+    void CloseDir(DirReader &reader);
+    bool GetMetadata(const std::string &device, const std::string &path, DirEntry &entry);
+    time_t GetModifiedTime(const std::string &path);
+    bool ChangeDirNext(const std::string &path, DirListing &entries);
+    bool ChangeDirPrev(DirListing &entries);
+    bool GetTimeStamp(DirEntry &entry, FsTimeStampRaw &timestamp);
+    bool Rename(DirEntry &entry, const std::string &dest_path);
+    bool IsDotEntry(const char *name);
+    bool Delete(DirEntry &entry);
+    void Copy(DirEntry &entry, const std::string &path);
     bool Paste(void);
     bool Move(void);
-    FileType GetFileType(const std::string &filename);
+    FileType GetFileType(const char *filename);
     Result SetArchiveBit(const std::string &path);
     Result GetFreeStorageSpace(s64 &size);
     Result GetTotalStorageSpace(s64 &size);
     Result GetUsedStorageSpace(s64 &size);
-    std::string BuildPath(FsDirectoryEntry &entry);
+    std::string BuildPath(DirEntry &entry);
     std::string BuildPath(const std::string &path, bool device_name);
     std::string GetFileExt(const std::string &filename);
 }
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <string>
+#include <switch.h>
+#include <vector>
+
+#include "fs.hpp"
+#include "search.hpp"
+
+namespace Index {
+    bool Begin(const std::string &device);
+    void End(void);
+    void Find(const std::vector<std::string> &tokens, std::vector<SearchResult> &results);
+    void GetFolders(std::vector<std::string> &paths);
+    time_t GetFolderTime(const std::string &path);
+    bool HasFolder(const std::string &path);
+    void SetFolder(const std::string &path, time_t mtime, const DirListing &entries, std::vector<const DirEntry *> &added, std::vector<std::string> &removed);
+    void RemoveFolder(const std::string &path);
+    void EntryAdded(const std::string &device, const std::string &path, const DirEntry &entry);
+    void EntryRemoved(const std::string &device, const std::string &path, const DirEntry &entry);
+    void Invalidate(const std::string &device, const std::string &path);
+    void Save(void);
+}
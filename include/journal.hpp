@@ -0,0 +1,19 @@
+#pragma once
+
+#include <string>
+#include <switch.h>
+
+namespace Journal {
+    // What a file's source looked like when it was copied, its records only count while it still does.
+    typedef struct {
+        s64 size = 0;
+        u64 mtime = 0;
+    } Source;
+
+    bool Begin(const std::string &src_path, const std::string &dest_path, u8 type);
+    void End(bool finished);
+    bool IsDone(const std::string &path, const Source &source);
+    s64 GetOffset(const std::string &path, const Source &source);
+    void SetOffset(const std::string &path, const Source &source, s64 offset);
+    void SetDone(const std::string &path, const Source &source);
+}
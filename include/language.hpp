@@ -32,6 +32,7 @@ namespace Lang {
         PropertiesAccessed,
         PropertiesWidth,
         PropertiesHeight,
+        PropertiesContains,
 
         // Delete dialog
         DeleteMessage,
@@ -58,6 +59,9 @@ namespace Lang {
         SettingsImageViewFilenameToggle,
         SettingsDevOptsLogsToggle,
         SettingsMultiLangLogsToggle,
+        SettingsSortNaturalToggle,
+        SettingsCopyTitle,
+        SettingsCopyVerifyNone,
         SettingsAboutVersion,
         SettingsAboutAuthor,
         SettingsAboutBanner,
@@ -78,6 +82,19 @@ namespace Lang {
         // Keyboard
         KeyboardEmpty,
 
+        // File browser filter
+        FilterButton,
+        FilterPrompt,
+        FilterClear,
+
+        // Search tab
+        SearchButton,
+        SearchPrompt,
+        SearchStatus,
+
+        // Transfer
+        TransferStatus,
+
         // Max
         Max
     } StringID;
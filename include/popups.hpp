@@ -23,6 +23,5 @@ namespace Popups {
     void ImageProperties(bool &state, Tex &texture, bool &file_stat);
     void OptionsPopup(WindowData &data);
     void UpdatePopup(bool &state, bool &connection_status, bool &available, const std::string &tag);
-    void ProgressBar(float offset, float size, const std::string &title, const std::string &text);
     void USBPopup(bool &state);
 }
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <string>
+#include <switch.h>
+#include <vector>
+
+typedef struct {
+    std::string path;
+    std::string name;
+    u8 type = FsDirEntryType_File;
+    u8 file_type = 0;
+} SearchResult;
+
+namespace Search {
+    void Start(const std::string &device, const std::string &query);
+    bool Poll(std::vector<SearchResult> &results);
+    bool Busy(void);
+    u64 GetFolderCount(void);
+    void Cancel(void);
+}
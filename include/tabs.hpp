@@ -1,5 +1,6 @@
 #pragma once
 
+#include <string>
 #include <switch.h>
 #include <vector>
 
@@ -8,5 +9,7 @@
 
 namespace Tabs {
     void FileBrowser(WindowData &data);
+    void OpenFolder(WindowData &data, const std::string &folder_device, const std::string &path);
+    void Search(WindowData &data);
     void Settings(WindowData &data);
 }
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <string>
+#include <switch.h>
+#include <vector>
+
+typedef enum TransferVerify {
+    TransferVerifyNone,
+    TransferVerifyCRC32C,
+    TransferVerifySHA256
+} TransferVerify;
+
+// What was pasted where, so the file browser can add the entry once it's been copied.
+typedef struct {
+    std::string src_path;
+    std::string dest_device;
+    std::string dest_folder;
+    std::string name;
+    u8 type = FsDirEntryType_File;
+    int verify = TransferVerifyNone;
+    bool success = false;
+} TransferJob;
+
+// offset and size are for the file being copied, job_offset and job_size for the whole job.
+// The rates are per second and eta is in seconds, 0 while there's nothing to go on yet.
+typedef struct {
+    std::string name;
+    u64 offset = 0;
+    u64 size = 0;
+    u64 job_offset = 0;
+    u64 job_size = 0;
+    u64 jobs_left = 0;
+    double bytes_rate = 0.0;
+    double files_rate = 0.0;
+    u64 eta = 0;
+} TransferProgress;
+
+namespace Transfer {
+    void Add(const TransferJob &job);
+    bool Poll(std::vector<TransferJob> &finished);
+    void GetProgress(TransferProgress &progress);
+    bool Busy(void);
+    void Cancel(void);
+    void Suspend(void);
+    void SuspendDevice(const std::string &device);
+    void Exit(void);
+}
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <string>
 #include <switch.h>
 #include <vector>
 
@@ -8,4 +9,5 @@ namespace USB {
     void Exit(void);
     void Unmount(void);
     bool Connected(void);
+    u64 GetFileSizeLimit(const std::string &device);
 }
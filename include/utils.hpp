@@ -6,4 +6,5 @@ extern char __application_path[FS_MAX_PATH];
 
 namespace Utils {
     void GetSizeString(char *string, double size);
+    u32 CRC32C(u32 crc, const void *data, std::size_t size);
 }
@@ -2,9 +2,11 @@
 
 #include <string>
 #include <switch.h>
+#include <unordered_map>
 #include <vector>
 #include <mutex>
 
+#include "fs.hpp"
 #include "textures.hpp"
 
 enum WINDOW_STATES {
@@ -22,21 +24,23 @@ enum FS_SORT_STATE {
     FS_SORT_ALPHA_ASC = 0,
     FS_SORT_ALPHA_DESC,
     FS_SORT_SIZE_ASC,
-    FS_SORT_SIZE_DESC
+    FS_SORT_SIZE_DESC,
+    FS_SORT_DATE_ASC,
+    FS_SORT_DATE_DESC
 };
 
+// Checked entries of one folder, keyed by name so they stay checked when the listing is sorted or read again.
+// The value is the entry's type, which is all multi-item operations need besides the name.
 typedef struct {
-    std::vector<bool> checked;
-    std::vector<bool> checked_copy;
+    std::unordered_map<std::string, u8> checked;
     std::string cwd = "";
     std::string device = "";
-    u64 count = 0;
 } WindowCheckboxData;
 
 typedef struct {
     WINDOW_STATES state = WINDOW_STATE_FILEBROWSER;
     u64 selected = 0;
-    std::vector<FsDirectoryEntry> entries;
+    DirListing entries;
     WindowCheckboxData checkbox_data;
     s64 used_storage = 0;
     s64 total_storage = 0;
@@ -51,8 +55,12 @@ extern std::vector<std::string> devices_list;
 extern std::recursive_mutex devices_list_mutex;
 
 namespace FileBrowser {
-    bool Sort(const FsDirectoryEntry &entryA, const FsDirectoryEntry &entryB);
-    bool TableSort(const FsDirectoryEntry &entryA, const FsDirectoryEntry &entryB);
+    void SortEntries(DirListing &entries, int sort_mode, std::size_t offset);
+    void AddEntry(WindowData &data, const std::string &name, u8 type);
+    void RemoveEntry(WindowData &data, const DirEntry &entry);
+    void RemoveEntries(WindowData &data, const std::vector<DirEntry> &entries);
+    std::vector<std::string> GetMatchTokens(const std::string &query);
+    bool MatchEntry(const DirEntry &entry, const std::vector<std::string> &tokens);
 }
 
 namespace ImageViewer {
@@ -67,6 +75,8 @@ namespace Windows {
     void SetupWindow(void);
     void ExitWindow(void);
     void ResetCheckbox(WindowData &data);
-    void MainWindow(WindowData &data, u64 &key, bool progress);
+    bool IsChecked(const WindowData &data, const DirEntry &entry);
+    void ToggleCheckbox(WindowData &data, const DirEntry &entry);
+    void MainWindow(WindowData &data, u64 &key);
     void ImageViewer(bool &properties, bool &file_stat);
 }
@@ -6,20 +6,34 @@
 #include "fs.hpp"
 #include "log.hpp"
 
-#define CONFIG_VERSION 5
+#define CONFIG_VERSION 8
 
 config_t cfg;
 
 namespace Config {
     static const char *config_path = "/switch/NX-Shell/config.json";
-    static const char *config_file = "{\n\t\"config_version\": %d,\n\t\"language\": %d,\n\t\"dev_options\": %d,\n\t\"image_filename\": %d,\n\t\"multi_lang\": %d\n}";
+    static const char *config_file = "{\n\t\"config_version\": %d,\n\t\"language\": %d,\n\t\"dev_options\": %d,\n\t\"image_filename\": %d,\n\t\"multi_lang\": %d,\n\t\"natural_sort\": %d,\n\t\"verify_copies\": %d,\n\t\"copy_block_sizes\": {%s}\n}";
     static int config_version_holder = 0;
-    static const int buf_size = 128;
+    static const int buf_size = 256;
     
     int Save(config_t &config) {
         Result ret = 0;
-        char *buf = new char[buf_size];
-        u64 len = std::snprintf(buf, buf_size, config_file, CONFIG_VERSION, config.lang, config.dev_options, config.image_filename, config.multi_lang);
+
+        // Block sizes the copy engine settled on, keyed by "source>destination" device
+        std::string block_sizes;
+        for (const auto &[device_pair, block_size] : config.copy_block_sizes) {
+            block_sizes.append(block_sizes.empty()? "\n\t\t\"" : ",\n\t\t\"");
+            block_sizes.append(device_pair);
+            block_sizes.append("\": ");
+            block_sizes.append(std::to_string(block_size));
+        }
+
+        if (!block_sizes.empty())
+            block_sizes.append("\n\t");
+
+        const int size = buf_size + static_cast<int>(block_sizes.length());
+        char *buf = new char[size];
+        u64 len = std::snprintf(buf, size, config_file, CONFIG_VERSION, config.lang, config.dev_options, config.image_filename, config.multi_lang, config.natural_sort, config.verify_copies, block_sizes.c_str());
         
         // Delete and re-create the file, we don't care about the return value here.
         fsFsDeleteFile(std::addressof(devices[FileSystemSDMC]), config_path);
@@ -108,6 +122,21 @@ namespace Config {
         json_t *multi_lang = json_object_get(root, "multi_lang");
         cfg.multi_lang = json_integer_value(multi_lang);
 
+        json_t *natural_sort = json_object_get(root, "natural_sort");
+        cfg.natural_sort = json_integer_value(natural_sort);
+
+        json_t *verify_copies = json_object_get(root, "verify_copies");
+        cfg.verify_copies = json_integer_value(verify_copies);
+
+        json_t *copy_block_sizes = json_object_get(root, "copy_block_sizes");
+        if ((copy_block_sizes) && (json_is_object(copy_block_sizes))) {
+            const char *device_pair = nullptr;
+            json_t *block_size = nullptr;
+
+            json_object_foreach(copy_block_sizes, device_pair, block_size)
+                cfg.copy_block_sizes[device_pair] = static_cast<u32>(json_integer_value(block_size));
+        }
+
         json_decref(root);
         return 0;
     }
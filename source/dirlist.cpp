@@ -0,0 +1,456 @@
+#include <algorithm>
+#include <atomic>
+#include <list>
+#include <mutex>
+
+#include "config.hpp"
+#include "dirlist.hpp"
+#include "log.hpp"
+#include "windows.hpp"
+
+namespace DirList {
+    // The first batch is kept small so the first rows can be drawn on the next frame,
+    // later batches grow to keep the per-frame merge cost low on huge folders.
+    static constexpr std::size_t first_batch_size = 64;
+    static constexpr std::size_t max_batch_size = 2048;
+    static constexpr std::size_t metadata_batch_size = 64;
+
+    // Listings of folders we navigated away from, most recently used first.
+    static constexpr std::size_t cache_dirs_max = 32;
+    static constexpr std::size_t cache_size_max = 0x1000000;
+
+    typedef struct {
+        std::string path;
+        DirListing entries;
+        time_t mtime = 0;
+        u64 fingerprint = 0;
+        int sort = -1;
+        bool natural_sort = false;
+    } DirListCacheEntry;
+
+    static std::list<DirListCacheEntry> cache;
+    static std::size_t cache_size = 0;
+
+    // State of the listing currently shown, only accessed from the UI thread.
+    static std::string current_path;
+    static time_t current_mtime = 0;
+    static u64 current_fingerprint = 0;
+    static bool current_complete = false, current_native = false;
+
+    static Thread thread = {0};
+    static bool thread_created = false, job_active = false, job_applied = false;
+    static std::atomic<bool> cancel = false, listed = true, done = true;
+
+    // Job parameters are set before the worker is started and results are only read once it's done.
+    static DirReader reader;
+    static std::string job_device, job_dir, job_path;
+    static time_t job_mtime = 0;
+    static u64 job_fingerprint = 0;
+    static bool job_revalidate = false, job_list = true;
+    static DirListing stat_list;
+
+    static std::mutex pending_mutex;
+    static DirListing pending;
+    static bool pending_replace = false;
+    static std::vector<DirEntry> pending_metadata;
+
+    // Order independent hash of a listing, used to tell whether a revalidated listing actually changed.
+    static u64 GetFingerprint(const DirEntry &entry) {
+        u64 hash = 0xCBF29CE484222325;
+
+        for (const char *c = entry.name; *c != '\0'; c++)
+            hash = (hash ^ static_cast<u8>(*c)) * 0x100000001B3;
+        
+        hash = (hash ^ static_cast<u8>(entry.type)) * 0x100000001B3;
+        hash = (hash ^ static_cast<u64>(entry.file_size)) * 0x100000001B3;
+        return hash;
+    }
+
+    // Only native listings come with file sizes, the fingerprint has to match what the reader returns.
+    static u64 GetListedFingerprint(const DirEntry &entry) {
+        DirEntry listed = entry;
+
+        if ((!current_native) || (entry.type == FsDirEntryType_Dir))
+            listed.file_size = 0;
+        
+        return DirList::GetFingerprint(listed);
+    }
+
+    static void Publish(DirListing &batch) {
+        if (batch.empty())
+            return;
+
+        std::scoped_lock lock(pending_mutex);
+        pending.Append(batch);
+    }
+
+    static void ListEntries(void) {
+        time_t mtime = FS::GetModifiedTime(job_path);
+
+        // A zero mtime means the filesystem doesn't report one for folders, so we can't skip the re-listing.
+        if ((job_revalidate) && (mtime != 0) && (mtime == job_mtime))
+            return;
+
+        if ((job_revalidate) && (!FS::OpenDir(job_device, job_dir, reader)))
+            return;
+
+        std::size_t batch_size = first_batch_size;
+        DirListing batch, listed;
+        u64 fingerprint = 0;
+
+        // The batches are handed over to the UI, so keep our own copy of the names for the metadata pass.
+        listed.AddParent();
+
+        if (job_revalidate)
+            batch.AddParent();
+
+        while (!cancel) {
+            std::size_t offset = batch.size();
+
+            // Revalidated listings replace the cached one in one go once complete.
+            if (FS::ReadDir(reader, batch, job_revalidate? max_batch_size : (batch_size - offset)) == 0)
+                break;
+            
+            for (std::size_t i = offset; i < batch.size(); i++) {
+                fingerprint += DirList::GetFingerprint(batch[i]);
+                listed.Add(batch[i].name, batch[i].type, batch[i].file_size).flags |= batch[i].flags;
+            }
+
+            if ((!job_revalidate) && (batch.size() >= batch_size)) {
+                DirList::Publish(batch);
+                batch_size = std::min(batch_size * 2, max_batch_size);
+            }
+        }
+
+        FS::CloseDir(reader);
+
+        if (!cancel) {
+            if (!job_revalidate) {
+                DirList::Publish(batch);
+                stat_list = std::move(listed);
+            }
+            else if (fingerprint != job_fingerprint) {
+                std::scoped_lock lock(pending_mutex);
+                pending = std::move(batch);
+                pending_replace = true;
+                stat_list = std::move(listed);
+            }
+            
+            job_mtime = mtime;
+            job_fingerprint = fingerprint;
+        }
+    }
+
+    // Sizes and modification times are filled in after the listing, a batch of entries at a time.
+    static void ReadMetadata(void) {
+        std::vector<DirEntry> metadata;
+
+        for (std::size_t i = 0; (i < stat_list.size()) && (!cancel); i++) {
+            DirEntry &entry = stat_list[i];
+            if ((entry.flags & DirEntryFlagParent) || (entry.flags & DirEntryFlagTime))
+                continue;
+
+            FS::GetMetadata(job_device, job_dir, entry);
+            metadata.push_back(entry);
+
+            if (metadata.size() >= metadata_batch_size) {
+                std::scoped_lock lock(pending_mutex);
+                pending_metadata.insert(pending_metadata.end(), metadata.begin(), metadata.end());
+                metadata.clear();
+            }
+        }
+
+        if ((!cancel) && (!metadata.empty())) {
+            std::scoped_lock lock(pending_mutex);
+            pending_metadata.insert(pending_metadata.end(), metadata.begin(), metadata.end());
+        }
+
+        stat_list.clear();
+    }
+
+    static void ListThreadFunc(void *arg) {
+        (void)arg;
+
+        if (job_list)
+            DirList::ListEntries();
+        
+        listed = true;
+
+        DirList::ReadMetadata();
+        done = true;
+    }
+
+    // Without list only the metadata pass over stat_list is run.
+    static void StartThread(bool list) {
+        Result ret = 0;
+        job_list = list;
+        listed = false;
+        done = false;
+        job_active = true;
+        job_applied = false;
+
+        if (R_FAILED(ret = threadCreate(std::addressof(thread), ListThreadFunc, nullptr, nullptr, 0x10000, 0x2C, -2))) {
+            Log::Error("DirList::StartThread threadCreate() failed: 0x%x\n", ret);
+            DirList::ListThreadFunc(nullptr);
+            return;
+        }
+
+        if (R_FAILED(ret = threadStart(std::addressof(thread)))) {
+            Log::Error("DirList::StartThread threadStart() failed: 0x%x\n", ret);
+            threadClose(std::addressof(thread));
+            DirList::ListThreadFunc(nullptr);
+            return;
+        }
+
+        thread_created = true;
+    }
+
+    static void Store(DirListing &entries) {
+        std::size_t size = entries.GetMemoryUsage();
+        if (size > cache_size_max)
+            return;
+        
+        DirListCacheEntry cache_entry;
+        cache_entry.path = current_path;
+        cache_entry.entries = std::move(entries);
+        cache_entry.mtime = current_mtime;
+        cache_entry.fingerprint = current_fingerprint;
+        cache_entry.sort = sort;
+        cache_entry.natural_sort = cfg.natural_sort;
+        cache.push_front(std::move(cache_entry));
+        cache_size += size;
+
+        while ((cache.size() > cache_dirs_max) || (cache_size > cache_size_max)) {
+            cache_size -= cache.back().entries.GetMemoryUsage();
+            cache.pop_back();
+        }
+    }
+
+    // Only entries that didn't get metadata yet need another pass.
+    static void QueueMetadata(const DirListing &entries) {
+        stat_list.clear();
+
+        for (const DirEntry &entry : entries) {
+            if ((entry.flags & DirEntryFlagParent) || (entry.flags & DirEntryFlagTime))
+                continue;
+            
+            DirEntry &stat_entry = stat_list.Add(entry.name, entry.type, entry.file_size);
+            stat_entry.id = entry.id;
+            stat_entry.flags = entry.flags;
+        }
+    }
+
+    bool Start(const std::string &device, const std::string &path, DirListing &entries) {
+        std::string full_path = device + path;
+        DirListCacheEntry cached;
+        DirReader new_reader;
+
+        auto cache_entry = std::find_if(cache.begin(), cache.end(), [&full_path](const DirListCacheEntry &entry) {
+            return (entry.path == full_path);
+        });
+
+        bool cache_hit = (cache_entry != cache.end());
+        if (cache_hit) {
+            cache_size -= cache_entry->entries.GetMemoryUsage();
+            cached = std::move(*cache_entry);
+            cache.erase(cache_entry);
+        }
+        else if (!FS::OpenDir(device, path, new_reader))
+            return false;
+
+        // Navigating away from a folder that is still being listed cancels it, only complete listings are cached.
+        DirList::Cancel();
+
+        if ((current_complete) && (!current_path.empty()) && (current_path != full_path))
+            DirList::Store(entries);
+
+        current_path = full_path;
+        current_native = (FS::GetFileSystem(device) != nullptr);
+        job_device = device;
+        job_dir = path;
+        job_path = full_path;
+
+        if (cache_hit) {
+            // Show the cached listing straight away and check whether it's still up to date in the background.
+            entries = std::move(cached.entries);
+            current_mtime = cached.mtime;
+            current_fingerprint = cached.fingerprint;
+
+            if ((cached.sort != sort) || (cached.natural_sort != cfg.natural_sort))
+                sort = -1;
+            
+            current_complete = true;
+            DirList::QueueMetadata(entries);
+        }
+        else {
+            entries.clear();
+            entries.AddParent();
+
+            reader = std::move(new_reader);
+            stat_list.clear();
+            current_mtime = 0;
+            current_fingerprint = 0;
+            current_complete = false;
+        }
+
+        job_mtime = current_mtime;
+        job_fingerprint = current_fingerprint;
+        job_revalidate = cache_hit;
+        DirList::StartThread(true);
+        return true;
+    }
+
+    bool Poll(DirListing &entries, std::size_t &offset) {
+        bool ret = false;
+
+        // Everything is published before listed is set, so once it's set the pending entries are the last ones.
+        bool finished = listed;
+
+        {
+            std::scoped_lock lock(pending_mutex);
+
+            if (pending_replace) {
+                offset = 0;
+                entries = std::move(pending);
+                pending.clear();
+                pending_replace = false;
+                ret = true;
+            }
+            else if (!pending.empty()) {
+                offset = entries.size();
+                entries.Append(pending);
+                ret = true;
+            }
+        }
+
+        if ((finished) && (job_active) && (!job_applied)) {
+            current_mtime = job_mtime;
+            current_fingerprint = job_fingerprint;
+            current_complete = true;
+            job_applied = true;
+        }
+
+        if ((done) && (job_active)) {
+            if (thread_created) {
+                threadWaitForExit(std::addressof(thread));
+                threadClose(std::addressof(thread));
+                thread_created = false;
+            }
+
+            job_active = false;
+        }
+
+        return ret;
+    }
+
+    bool UpdateMetadata(DirListing &entries) {
+        std::vector<DirEntry> metadata;
+
+        {
+            std::scoped_lock lock(pending_mutex);
+            metadata.swap(pending_metadata);
+        }
+
+        if (metadata.empty())
+            return false;
+
+        // Entries may have been sorted since they were listed, so look them up by id.
+        u32 max_id = 0;
+        for (const DirEntry &entry : entries)
+            max_id = std::max(max_id, entry.id);
+        
+        std::vector<u32> positions(max_id + 1, UINT32_MAX);
+        for (std::size_t i = 0; i < entries.size(); i++)
+            positions[entries[i].id] = i;
+        
+        for (const DirEntry &result : metadata) {
+            if ((result.id > max_id) || (positions[result.id] == UINT32_MAX))
+                continue;
+            
+            DirEntry &entry = entries[positions[result.id]];
+            entry.file_size = result.file_size;
+            entry.modified = result.modified;
+            entry.flags |= (result.flags & (DirEntryFlagSize | DirEntryFlagTime));
+        }
+
+        return true;
+    }
+
+    // sdmc and BIS report a zero mtime for folders, so there's no cheap way to tell whether they changed.
+    // Those are only checked again when the folder is opened from the cache, not every few seconds.
+    bool Revalidate(DirListing &entries) {
+        if ((job_active) || (!current_complete) || (current_path.empty()) || (current_mtime == 0))
+            return false;
+        
+        job_mtime = current_mtime;
+        job_fingerprint = current_fingerprint;
+        job_revalidate = true;
+        DirList::QueueMetadata(entries);
+        DirList::StartThread(true);
+        return true;
+    }
+
+    bool Modify(DirListing &entries) {
+        if (!current_complete)
+            return false;
+        
+        // Once the listing has been taken in, the metadata pass can keep going, it finds entries by id and new ones never reuse one.
+        if ((!job_active) || ((listed) && (job_applied)))
+            return true;
+        
+        // A listing still running in the background could bring back what the file operation just changed. Whatever's left
+        // of the metadata starts over, entries the operation removes are skipped when it comes in.
+        DirList::Cancel();
+        DirList::QueueMetadata(entries);
+        DirList::StartThread(false);
+        job_applied = true;
+        return true;
+    }
+
+    void EntryAdded(const DirEntry &entry) {
+        current_fingerprint += DirList::GetListedFingerprint(entry);
+    }
+
+    void EntryRemoved(const DirEntry &entry) {
+        current_fingerprint -= DirList::GetListedFingerprint(entry);
+    }
+
+    bool Busy(void) {
+        return job_active;
+    }
+
+    void Cancel(void) {
+        if (thread_created) {
+            cancel = true;
+            threadWaitForExit(std::addressof(thread));
+            threadClose(std::addressof(thread));
+            thread_created = false;
+            cancel = false;
+        }
+
+        job_active = false;
+
+        std::scoped_lock lock(pending_mutex);
+        pending.clear();
+        pending_replace = false;
+        pending_metadata.clear();
+    }
+
+    void Invalidate(const std::string &path) {
+        auto cache_entry = std::find_if(cache.begin(), cache.end(), [&path](const DirListCacheEntry &entry) {
+            return (entry.path == path);
+        });
+
+        if (cache_entry != cache.end()) {
+            cache_size -= cache_entry->entries.GetMemoryUsage();
+            cache.erase(cache_entry);
+        }
+    }
+
+    void ClearCache(void) {
+        cache.clear();
+        cache_size = 0;
+        current_path.clear();
+        current_complete = false;
+    }
+}
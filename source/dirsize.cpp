@@ -0,0 +1,167 @@
+#include <atomic>
+#include <unordered_map>
+#include <vector>
+
+#include "dirsize.hpp"
+#include "fs.hpp"
+#include "log.hpp"
+
+namespace DirSize {
+    typedef struct {
+        time_t mtime = 0;
+        DirSizeResult result;
+    } DirSizeCacheEntry;
+
+    // Totals of folders we already walked, reused while the folder's mtime is unchanged. sdmc and BIS report a zero
+    // mtime for folders, so file operations drop the totals they make stale through Invalidate.
+    static std::unordered_map<std::string, DirSizeCacheEntry> cache;
+
+    static Thread thread = {0};
+    static bool thread_created = false;
+    static std::atomic<bool> cancel = false, done = true;
+    static std::atomic<s64> total_size = 0;
+    static std::atomic<u64> total_files = 0, total_folders = 0;
+
+    static std::string job_device, job_path, job_full_path;
+    static time_t job_mtime = 0;
+    static DirSizeResult cached_result;
+    static bool cached = false, job_invalidated = false;
+
+    // Whether path is folder or somewhere inside it.
+    static bool IsWithin(const std::string &path, const std::string &folder) {
+        if (path.compare(0, folder.length(), folder) != 0)
+            return false;
+        
+        return ((path.length() == folder.length()) || (folder.back() == '/') || (path[folder.length()] == '/'));
+    }
+
+    static void SizeThreadFunc(void *arg) {
+        (void)arg;
+
+        std::vector<std::string> folders;
+        folders.push_back(job_path);
+        DirListing batch;
+        DirReader reader;
+
+        // Walk the tree one folder at a time, the counters are read by the UI while we go.
+        while ((!folders.empty()) && (!cancel)) {
+            std::string path = std::move(folders.back());
+            folders.pop_back();
+
+            if (!FS::OpenDir(job_device, path, reader))
+                continue;
+
+            while ((!cancel) && (FS::ReadDir(reader, batch, 256) != 0)) {
+                for (DirEntry &entry : batch) {
+                    if (entry.type == FsDirEntryType_Dir) {
+                        std::string folder_path = path;
+                        folder_path.append((path.compare("/") == 0)? "" : "/");
+                        folder_path.append(entry.name);
+                        folders.push_back(std::move(folder_path));
+                        total_folders++;
+                        continue;
+                    }
+
+                    // Only native listings come with file sizes
+                    if (!(entry.flags & DirEntryFlagSize))
+                        FS::GetMetadata(job_device, path, entry);
+
+                    total_size += entry.file_size;
+                    total_files++;
+                }
+
+                batch.clear();
+            }
+
+            FS::CloseDir(reader);
+        }
+
+        done = true;
+    }
+
+    void Start(const std::string &device, const std::string &path) {
+        DirSize::Cancel();
+
+        job_device = device;
+        job_path = path;
+        job_full_path = device + path;
+        job_mtime = FS::GetModifiedTime(job_full_path);
+
+        auto cache_entry = cache.find(job_full_path);
+        if ((cache_entry != cache.end()) && (cache_entry->second.mtime == job_mtime)) {
+            cached_result = cache_entry->second.result;
+            cached = true;
+            return;
+        }
+
+        cached = false;
+        job_invalidated = false;
+        total_size = 0;
+        total_files = 0;
+        total_folders = 0;
+        done = false;
+
+        Result ret = 0;
+        if (R_FAILED(ret = threadCreate(std::addressof(thread), SizeThreadFunc, nullptr, nullptr, 0x10000, 0x2C, -2))) {
+            Log::Error("DirSize::Start threadCreate() failed: 0x%x\n", ret);
+            DirSize::SizeThreadFunc(nullptr);
+            return;
+        }
+
+        if (R_FAILED(ret = threadStart(std::addressof(thread)))) {
+            Log::Error("DirSize::Start threadStart() failed: 0x%x\n", ret);
+            threadClose(std::addressof(thread));
+            DirSize::SizeThreadFunc(nullptr);
+            return;
+        }
+
+        thread_created = true;
+    }
+
+    void Get(DirSizeResult &result) {
+        if (cached) {
+            result = cached_result;
+            return;
+        }
+
+        result.size = total_size;
+        result.files = total_files;
+        result.folders = total_folders;
+        result.done = done;
+
+        if ((result.done) && (thread_created)) {
+            threadWaitForExit(std::addressof(thread));
+            threadClose(std::addressof(thread));
+            thread_created = false;
+
+            if ((!cancel) && (!job_invalidated)) {
+                cache[job_full_path] = { job_mtime, result };
+                cached_result = result;
+                cached = true;
+            }
+        }
+    }
+
+    void Cancel(void) {
+        if (thread_created) {
+            cancel = true;
+            threadWaitForExit(std::addressof(thread));
+            threadClose(std::addressof(thread));
+            thread_created = false;
+            cancel = false;
+        }
+
+        cached = false;
+    }
+
+    // Drops the totals of path, the folders it's in and the ones inside it. Only called from the UI thread, like Start.
+    void Invalidate(const std::string &path) {
+        std::erase_if(cache, [&path](const auto &entry) {
+            return ((DirSize::IsWithin(path, entry.first)) || (DirSize::IsWithin(entry.first, path)));
+        });
+
+        // A walk still running may have counted what changed
+        if ((thread_created) && ((DirSize::IsWithin(path, job_full_path)) || (DirSize::IsWithin(job_full_path, path))))
+            job_invalidated = true;
+    }
+}
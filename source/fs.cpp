@@ -1,14 +1,16 @@
 #include <algorithm>
+#include <atomic>
 #include <cstdio>
 #include <cstring>
 #include <dirent.h>
 #include <filesystem>
 
 #include "config.hpp"
+#include "dirlist.hpp"
+#include "dirsize.hpp"
 #include "fs.hpp"
-#include "language.hpp"
 #include "log.hpp"
-#include "popups.hpp"
+#include "transfer.hpp"
 
 // Global vars
 FsFileSystem *fs;
@@ -16,7 +18,116 @@ FsFileSystem devices[FileSystemMax];
 std::string cwd = "/";
 std::string device = "sdmc:";
 
+// Shared by all listings so a listing moved into another one never ends up with a revision it had before.
+static std::atomic<u64> listing_revision = 0;
+
+void DirListing::Touch(void) {
+    revision = ++listing_revision;
+}
+
+DirEntry &DirListing::Add(const char *name, u8 type, s64 file_size) {
+    std::size_t length = std::strlen(name);
+
+    if (block_offset + ((length + 1) * 2) > block_size) {
+        blocks.push_back(std::make_unique<char[]>(block_size));
+        block_offset = 0;
+    }
+
+    char *block_name = blocks.back().get() + block_offset;
+    std::memcpy(block_name, name, length + 1);
+
+    // Only ASCII is folded, same as strcasecmp()
+    char *block_key = block_name + length + 1;
+    for (std::size_t i = 0; i <= length; i++)
+        block_key[i] = ((name[i] >= 'A') && (name[i] <= 'Z'))? (name[i] + ('a' - 'A')) : name[i];
+    
+    block_offset += (length + 1) * 2;
+
+    DirEntry entry;
+    entry.name = block_name;
+    entry.id = next_id++;
+    entry.file_size = file_size;
+    entry.name_length = static_cast<u16>(length);
+    entry.type = type;
+    entry.file_type = (type == FsDirEntryType_File)? FS::GetFileType(name) : FileTypeNone;
+    entries.push_back(entry);
+    this->Touch();
+    return entries.back();
+}
+
+DirEntry &DirListing::AddParent(void) {
+    DirEntry &entry = this->Add("..", FsDirEntryType_Dir, 0);
+    entry.flags |= DirEntryFlagParent;
+    return entry;
+}
+
+void DirListing::Append(DirListing &other) {
+    entries.reserve(entries.size() + other.entries.size());
+
+    for (DirEntry entry : other.entries) {
+        entry.id = next_id++;
+        entries.push_back(entry);
+    }
+    
+    // Take over the other listing's blocks, its last block becomes the one we keep filling.
+    if (!other.blocks.empty()) {
+        blocks.insert(blocks.end(), std::make_move_iterator(other.blocks.begin()), std::make_move_iterator(other.blocks.end()));
+        block_offset = other.block_offset;
+    }
+
+    other.clear();
+    this->Touch();
+}
+
+// Reorders the entries so that entry i becomes the one previously at order[i].
+void DirListing::Permute(const std::vector<u32> &order) {
+    std::vector<DirEntry> sorted;
+    sorted.reserve(order.size());
+
+    for (u32 index : order)
+        sorted.push_back(entries[index]);
+    
+    entries.swap(sorted);
+    this->Touch();
+}
+
+// The name stays in its block until the listing is cleared.
+void DirListing::Remove(std::size_t index) {
+    entries.erase(entries.begin() + index);
+    this->Touch();
+}
+
+void DirListing::clear(void) {
+    entries.clear();
+    blocks.clear();
+    block_offset = block_size;
+    next_id = 0;
+    this->Touch();
+}
+
+std::size_t DirListing::GetMemoryUsage(void) const {
+    return (entries.capacity() * sizeof(DirEntry)) + (blocks.size() * block_size);
+}
+
+PathBuilder::PathBuilder(std::string_view base) {
+    path.reserve(FS_MAX_PATH);
+    path.assign(base);
+}
+
+// Appends a component and returns the length to Pop() back to.
+std::size_t PathBuilder::Push(std::string_view name) {
+    std::size_t length = path.length();
+
+    if ((path.empty()) || (path.back() != '/'))
+        path.push_back('/');
+    
+    path.append(name);
+    return length;
+}
+
 namespace FS {
+    // Number of entries fetched per fsDirRead() call.
+    static constexpr std::size_t dir_read_count = 256;
 
     typedef struct {
         std::string path;
@@ -49,59 +160,148 @@ namespace FS {
         return true;
     }
     
-    bool GetDirList(const std::string &device, const std::string &path, std::vector<FsDirectoryEntry> &entries) {
-        DIR *dir = nullptr;
-        struct dirent *d_entry = nullptr;
-        
+    FsFileSystem *GetFileSystem(const std::string &device) {
+        static const char *device_names[FileSystemMax] = { "sdmc:", "safe:", "user:", "system:" };
+
+        for (int i = 0; i < FileSystemMax; i++) {
+            if (device.compare(device_names[i]) == 0)
+                return std::addressof(devices[i]);
+        }
+
+        return nullptr;
+    }
+
+    bool OpenDir(const std::string &device, const std::string &path, DirReader &reader) {
+        FsFileSystem *filesystem = FS::GetFileSystem(device);
+
+        if (filesystem) {
+            Result ret = 0;
+            char fs_path[FS_MAX_PATH];
+            std::snprintf(fs_path, FS_MAX_PATH, "%s", path.c_str());
+
+            if (R_FAILED(ret = fsFsOpenDirectory(filesystem, fs_path, FsDirOpenMode_ReadDirs | FsDirOpenMode_ReadFiles, std::addressof(reader.fs_dir)))) {
+                Log::Error("fsFsOpenDirectory(%s) failed: 0x%x\n", path.c_str(), ret);
+                return false;
+            }
+
+            reader.native = true;
+            reader.buffer = std::make_unique<FsDirectoryEntry[]>(dir_read_count);
+            return true;
+        }
+
         std::string full_path = device + path;
-        dir = opendir(full_path.c_str());
-        entries.clear();
+        if (!(reader.dir = opendir(full_path.c_str()))) {
+            Log::Error("FS::OpenDir(%s) failed to open path.\n", full_path.c_str());
+            return false;
+        }
 
-        if (dir) {
-            FsDirectoryEntry parent_entry;
-            std::memset(std::addressof(parent_entry), 0, sizeof(FsDirectoryEntry));
-            std::snprintf(parent_entry.name, 3, "..");
-            parent_entry.type = FsDirEntryType_Dir;
-            entries.push_back(parent_entry);
+        reader.native = false;
+        return true;
+    }
 
-            while((d_entry = readdir(dir))) {
-                FsDirectoryEntry entry;
-                std::memset(std::addressof(entry), 0, sizeof(FsDirectoryEntry));
+    // Appends up to max entries to the listing, returns 0 once the whole folder has been read.
+    std::size_t ReadDir(DirReader &reader, DirListing &entries, std::size_t max) {
+        std::size_t count = 0;
 
-                std::snprintf(entry.name, FS_MAX_PATH, d_entry->d_name);
-                entry.type = (d_entry->d_type & DT_DIR)? FsDirEntryType_Dir : FsDirEntryType_File;
-                entry.file_size = 0;
+        if (reader.native) {
+            Result ret = 0;
+            s64 read_count = 0;
 
-                entries.push_back(entry);
+            if (R_FAILED(ret = fsDirRead(std::addressof(reader.fs_dir), std::addressof(read_count), std::min(max, dir_read_count), reader.buffer.get()))) {
+                Log::Error("fsDirRead() failed: 0x%x\n", ret);
+                return 0;
             }
 
-            closedir(dir);
+            for (s64 i = 0; i < read_count; i++) {
+                DirEntry &entry = entries.Add(reader.buffer[i].name, reader.buffer[i].type, reader.buffer[i].file_size);
+                entry.flags |= DirEntryFlagSize;
+            }
+
+            return static_cast<std::size_t>(read_count);
         }
-        else {
-            Log::Error("FS::GetDirList(%s) to open path.\n", full_path.c_str());
+
+        struct dirent *d_entry = nullptr;
+        while ((count < max) && (d_entry = readdir(reader.dir))) {
+            entries.Add(d_entry->d_name, (d_entry->d_type & DT_DIR)? FsDirEntryType_Dir : FsDirEntryType_File, 0);
+            count++;
+        }
+
+        return count;
+    }
+
+    void CloseDir(DirReader &reader) {
+        if (reader.native)
+            fsDirClose(std::addressof(reader.fs_dir));
+        else if (reader.dir)
+            closedir(reader.dir);
+        
+        reader.dir = nullptr;
+        reader.native = false;
+        reader.buffer.reset();
+    }
+    
+    // Fills in whatever size/modification time the listing didn't provide, path is the entry's parent folder.
+    bool GetMetadata(const std::string &device, const std::string &path, DirEntry &entry) {
+        std::string entry_path = path;
+        entry_path.append((path.compare("/") == 0)? "" : "/");
+        entry_path.append(entry.name);
+
+        FsFileSystem *filesystem = FS::GetFileSystem(device);
+        if ((filesystem) && (entry.flags & DirEntryFlagSize)) {
+            Result ret = 0;
+            FsTimeStampRaw timestamp = { 0 };
+            char fs_path[FS_MAX_PATH];
+            std::snprintf(fs_path, FS_MAX_PATH, "%s", entry_path.c_str());
+
+            // Mark it as done either way so we don't keep trying, folders don't have a timestamp on every filesystem.
+            entry.flags |= DirEntryFlagTime;
+
+            if (R_FAILED(ret = fsFsGetFileTimeStampRaw(filesystem, fs_path, std::addressof(timestamp))) || (!timestamp.is_valid))
+                return false;
+
+            entry.modified = timestamp.modified;
+            return true;
+        }
+
+        struct stat file_stat = { 0 };
+        std::string full_path = device + entry_path;
+        entry.flags |= (DirEntryFlagSize | DirEntryFlagTime);
+
+        if (stat(full_path.c_str(), std::addressof(file_stat)) != 0) {
+            Log::Error("FS::GetMetadata(%s) failed to stat file.\n", full_path.c_str());
             return false;
         }
 
+        if (entry.type == FsDirEntryType_File)
+            entry.file_size = file_stat.st_size;
+        
+        entry.modified = file_stat.st_mtime;
         return true;
     }
 
-    static bool ChangeDir(const std::string &path, std::vector<FsDirectoryEntry> &entries) {
-        std::vector<FsDirectoryEntry> new_entries;
-        const std::string new_path = path;
-        cwd = path;
+    time_t GetModifiedTime(const std::string &path) {
+        struct stat dir_stat = { 0 };
+
+        if (stat(path.c_str(), std::addressof(dir_stat)) != 0)
+            return 0;
         
-        bool ret = FS::GetDirList(device, new_path, new_entries);
+        return dir_stat.st_mtime;
+    }
+
+    static bool ChangeDir(const std::string &path, DirListing &entries) {
+        // The listing itself is filled in by DirList::Poll as the background enumerator progresses.
+        if (!DirList::Start(device, path, entries))
+            return false;
         
-        entries.clear();
-        entries = new_entries;
-        return ret;
+        cwd = path;
+        return true;
     }
     
-    bool ChangeDirNext(const std::string &path, std::vector<FsDirectoryEntry> &entries) {
+    bool ChangeDirNext(const std::string &path, DirListing &entries) {
         return FS::ChangeDir(FS::BuildPath(path, false), entries);
     }
     
-    bool ChangeDirPrev(std::vector<FsDirectoryEntry> &entries) {
+    bool ChangeDirPrev(DirListing &entries) {
         // We are already at the root.
         if (cwd.compare("/") == 0)
             return false;
@@ -111,7 +311,7 @@ namespace FS {
         return FS::ChangeDir(parent_path.empty()? cwd : parent_path, entries);
     }
 
-    bool GetTimeStamp(FsDirectoryEntry &entry, FsTimeStampRaw &timestamp) {
+    bool GetTimeStamp(DirEntry &entry, FsTimeStampRaw &timestamp) {
         struct stat file_stat = { 0 };
         std::string full_path = FS::BuildPath(entry);
 
@@ -127,7 +327,7 @@ namespace FS {
         return true;
     }
 
-    bool Rename(FsDirectoryEntry &entry, const std::string &dest_path) {
+    bool Rename(DirEntry &entry, const std::string &dest_path) {
         std::string src_path = FS::BuildPath(entry);
         std::string full_dest_path = FS::BuildPath(dest_path, true);
 
@@ -139,30 +339,34 @@ namespace FS {
         return true;
     }
 
-    bool DeleteRecursive(const std::string &path) {
+    bool IsDotEntry(const char *name) {
+        return ((name[0] == '.') && ((name[1] == '\0') || ((name[1] == '.') && (name[2] == '\0'))));
+    }
+
+    static bool DeleteRecursive(PathBuilder &path) {
         DIR *dir = nullptr;
         struct dirent *entry = nullptr;
         dir = opendir(path.c_str());
 
         if (dir) {
             while((entry = readdir(dir))) {
-                std::string filename = entry->d_name;
-                if ((filename.compare(".") == 0) || (filename.compare("..") == 0))
+                if (FS::IsDotEntry(entry->d_name))
                     continue;
 
-                std::string file_path = path;
-                file_path.append(path.compare("/") == 0? "" : "/");
-                file_path.append(filename);
+                std::size_t length = path.Push(entry->d_name);
 
                 if (entry->d_type & DT_DIR) {
-                    FS::DeleteRecursive(file_path);
+                    FS::DeleteRecursive(path);
                 }
                 else {
-                    if (remove(file_path.c_str()) != 0) {
-                        Log::Error("FS::DeleteRecursive(%s) failed to delete file.\n", file_path.c_str());
+                    if (remove(path.c_str()) != 0) {
+                        Log::Error("FS::DeleteRecursive(%s) failed to delete file.\n", path.c_str());
+                        closedir(dir);
                         return false;
                     }
                 }
+
+                path.Pop(length);
             }
 
             closedir(dir);
@@ -175,11 +379,16 @@ namespace FS {
         return (rmdir(path.c_str()) == 0);
     }
     
-    bool Delete(FsDirectoryEntry &entry) {
+    bool Delete(DirEntry &entry) {
         std::string full_path = FS::BuildPath(entry);
 
+        // Even a delete that fails halfway changes the size of the folders it's in
+        DirSize::Invalidate(full_path);
+
         if (entry.type == FsDirEntryType_Dir) {
-            if (!FS::DeleteRecursive(full_path)) {
+            PathBuilder path(full_path);
+
+            if (!FS::DeleteRecursive(path)) {
                 Log::Error("FS::Delete(%s) failed to delete folder.\n", full_path.c_str());
                 return false;
             }
@@ -194,110 +403,12 @@ namespace FS {
         return true;
     }
     
-    static bool CopyFile(const std::string &src_path, const std::string &dest_path) {
-        FILE *src = fopen(src_path.c_str(), "rb");
-        if (!src) {
-            Log::Error("FS::CopyFile (%s) failed to open src file.\n", src_path.c_str());
-            return false;
-        }
-
-        struct stat file_stat = { 0 };
-        if (stat(src_path.c_str(), std::addressof(file_stat)) != 0) {
-            Log::Error("FS::CopyFile (%s) failed to get src file size.\n", src_path.c_str());
-            return false;
-        }
-
-        std::size_t size = file_stat.st_size;
-
-        FILE *dest = fopen(dest_path.c_str(), "wb");
-        if (!dest) {
-            Log::Error("FS::CopyFile (%s) failed to open dest file.\n", dest_path.c_str());
-            fclose(src);
-            return false;
-        }
+    void Copy(DirEntry &entry, const std::string &path) {
+        if (!(entry.flags & DirEntryFlagParent)) {
+            PathBuilder full_path(path);
+            full_path.Push(entry.name);
 
-        std::size_t bytes_read = 0, offset = 0;
-        const std::size_t buf_size = 0x10000;
-        unsigned char *buf = new unsigned char[buf_size];
-        std::string filename = std::filesystem::path(src_path).filename();
-
-        do {
-            std::memset(buf, 0, buf_size);
-
-            bytes_read = fread(buf, sizeof(unsigned char), buf_size, src);
-            if (bytes_read < 0) {
-                Log::Error("FS::CopyFile (%s) failed to read src file.\n", src_path.c_str());
-                delete[] buf;
-                fclose(src);
-                fclose(dest);
-                return false;
-            }
-            
-            std::size_t bytes_written = fwrite(buf, sizeof(unsigned char), bytes_read, dest);
-            if (bytes_written != bytes_read) {
-                Log::Error("FS::CopyFile (%s) failed to write to dest file.\n", dest_path.c_str());
-                delete[] buf;
-                fclose(src);
-                fclose(dest);
-                return false;
-            }
-            
-            offset += bytes_read;
-            Popups::ProgressBar(static_cast<float>(offset), static_cast<float>(size), strings[cfg.lang][Lang::OptionsCopying], filename.c_str());
-        } while (offset < size);
-
-        delete[] buf;
-        fclose(src);
-        fclose(dest);
-        return true;
-        return 0;
-    }
-
-    static bool CopyDir(const std::string &src_path, const std::string &dest_path) {
-        DIR *dir = nullptr;
-        struct dirent *entry = nullptr;
-        dir = opendir(src_path.c_str());
-
-        if (dir) {
-            // This may fail or not, but we don't care -> make the dir if it doesn't exist, otherwise continue.
-            mkdir(dest_path.c_str(), 0700);
-
-            while((entry = readdir(dir))) {
-                std::string filename = entry->d_name;
-                if ((filename.compare(".") == 0) || (filename.compare("..") == 0))
-                    continue;
-
-                std::string src = src_path;
-                src.append("/");
-                src.append(filename);
-
-                std::string dest = dest_path;
-                dest.append("/");
-                dest.append(filename);
-
-                if (entry->d_type & DT_DIR)
-                    FS::CopyDir(src.c_str(), dest.c_str()); // Copy Folder (via recursion)
-                else
-                    FS::CopyFile(src.c_str(), dest.c_str()); // Copy File
-            }
-
-            closedir(dir);
-        }
-        else {
-            Log::Error("FS::CopyDir(%s) failed to open path.\n", src_path.c_str());
-            return false;
-        }
-
-        return true;
-    }
-
-    void Copy(FsDirectoryEntry &entry, const std::string &path) {
-        std::string full_path = path;
-        full_path.append(path.compare("/") == 0? "" : "/");
-        full_path.append(entry.name);
-        
-        if ((std::strncmp(entry.name, "..", 2)) != 0) {
-            fs_copy_entry.path = full_path;
+            fs_copy_entry.path = full_path.view();
             fs_copy_entry.filename = entry.name;
             
             if (entry.type == FsDirEntryType_Dir)
@@ -305,17 +416,24 @@ namespace FS {
         }
     }
 
+    // The copy itself runs on the transfer thread, the entry shows up in the listing once it's done.
     bool Paste(void) {
-        bool ret = false;
-        std::string path = FS::BuildPath(fs_copy_entry.filename, true);
-        
-        if (fs_copy_entry.is_directory)
-            ret = FS::CopyDir(fs_copy_entry.path, path);
-        else
-            ret = FS::CopyFile(fs_copy_entry.path, path);
+        // Copying a file onto itself would replace it with an empty one
+        if (FS::BuildPath(fs_copy_entry.filename, true) == fs_copy_entry.path) {
+            Log::Error("FS::Paste(%s) source and destination are the same.\n", fs_copy_entry.path.c_str());
+            return false;
+        }
+
+        TransferJob job;
+        job.src_path = fs_copy_entry.path;
+        job.dest_device = device;
+        job.dest_folder = cwd;
+        job.name = fs_copy_entry.filename;
+        job.type = fs_copy_entry.is_directory? FsDirEntryType_Dir : FsDirEntryType_File;
+        Transfer::Add(job);
 
         fs_copy_entry = {};
-        return ret;
+        return true;
     }
 
     bool Move(void) {
@@ -326,20 +444,63 @@ namespace FS {
             return false;
         }
 
+        // The cached listing of the folder we moved from is stale now, and so are the sizes on both ends.
+        DirList::Invalidate(std::filesystem::path(fs_copy_entry.path).parent_path());
+        DirSize::Invalidate(fs_copy_entry.path);
+        DirSize::Invalidate(path);
         fs_copy_entry = {};
         return true;
     }
 
-    FileType GetFileType(const std::string &filename) {
-        std::string ext = FS::GetFileExt(filename);
+    // Packs an extension of up to 4 characters into an integer, upper-cased, so it can be used as a switch case.
+    static constexpr u32 PackFileExt(const char *ext) {
+        u32 packed = 0;
+
+        for (int i = 0; ext[i] != '\0'; i++) {
+            if (i == 4)
+                return 0;
+            
+            char c = ((ext[i] >= 'a') && (ext[i] <= 'z'))? (ext[i] - ('a' - 'A')) : ext[i];
+            packed = (packed << 8) | static_cast<u8>(c);
+        }
+
+        return packed;
+    }
+
+    FileType GetFileType(const char *filename) {
+        // Same rules as std::filesystem::path::extension(), a leading dot doesn't start an extension.
+        const char *ext = std::strrchr(filename, '.');
+        if ((!ext) || (ext == filename))
+            return FileTypeNone;
         
-        if ((!ext.compare(".ZIP")) || (!ext.compare(".RAR")) || (!ext.compare(".7Z")))
-            return FileTypeArchive;
-        else if ((!ext.compare(".BMP")) || (!ext.compare(".GIF")) || (!ext.compare(".JPG")) || (!ext.compare(".JPEG")) || (!ext.compare(".PGM"))
-            || (!ext.compare(".PPM")) || (!ext.compare(".PNG")) || (!ext.compare(".PSD")) || (!ext.compare(".TGA")) || (!ext.compare(".WEBP")))
-            return FileTypeImage;
-        else if ((!ext.compare(".JSON")) || (!ext.compare(".LOG")) || (!ext.compare(".TXT")) || (!ext.compare(".CFG")) || (!ext.compare(".INI")))
-            return FileTypeText;
+        switch (FS::PackFileExt(ext + 1)) {
+            case PackFileExt("ZIP"):
+            case PackFileExt("RAR"):
+            case PackFileExt("7Z"):
+                return FileTypeArchive;
+            
+            case PackFileExt("BMP"):
+            case PackFileExt("GIF"):
+            case PackFileExt("JPG"):
+            case PackFileExt("JPEG"):
+            case PackFileExt("PGM"):
+            case PackFileExt("PPM"):
+            case PackFileExt("PNG"):
+            case PackFileExt("PSD"):
+            case PackFileExt("TGA"):
+            case PackFileExt("WEBP"):
+                return FileTypeImage;
+            
+            case PackFileExt("JSON"):
+            case PackFileExt("LOG"):
+            case PackFileExt("TXT"):
+            case PackFileExt("CFG"):
+            case PackFileExt("INI"):
+                return FileTypeText;
+            
+            default:
+                break;
+        }
             
         return FileTypeNone;
     }
@@ -400,16 +561,20 @@ namespace FS {
         return ext;
     }
 
-    std::string BuildPath(FsDirectoryEntry &entry) {
-        std::string path_next = device;
+    // Sized up front so the result is built with a single allocation.
+    std::string BuildPath(DirEntry &entry) {
+        std::string path_next;
+        path_next.reserve(device.length() + cwd.length() + entry.name_length + 1);
+        path_next.append(device);
         path_next.append(cwd);
         path_next.append((cwd.compare("/") == 0)? "" : "/");
-        path_next.append(entry.name);
+        path_next.append(entry.name, entry.name_length);
         return path_next;
     }
 
     std::string BuildPath(const std::string &path, bool device_name) {
-        std::string path_next = "";
+        std::string path_next;
+        path_next.reserve((device_name? device.length() : 0) + cwd.length() + path.length() + 1);
 
         if (device_name)
             path_next.append(device);
@@ -0,0 +1,489 @@
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <string_view>
+#include <unordered_set>
+
+#include "index.hpp"
+#include "log.hpp"
+#include "windows.hpp"
+
+#define INDEX_MAGIC   0x4953584E // "NXSI"
+#define INDEX_VERSION 1
+
+namespace Index {
+    // Laid out the same in memory and on disk. The name and its case-folded key are stored
+    // back to back in the folder's names, like DirListing does, so the search matcher works on them unchanged.
+    typedef struct {
+        s64 file_size = 0;
+        s64 modified = 0;
+        u32 name_offset = 0;
+        u16 name_length = 0;
+        u8 type = FsDirEntryType_File;
+        u8 file_type = FileTypeNone;
+    } IndexEntry;
+
+    typedef struct {
+        u32 magic = INDEX_MAGIC;
+        u32 version = INDEX_VERSION;
+        u32 folder_count = 0;
+        u32 reserved = 0;
+    } IndexHeader;
+
+    // Each folder is one self-contained record, followed by its path, entries and names.
+    typedef struct {
+        s64 mtime = 0;
+        u32 path_length = 0;
+        u32 entry_count = 0;
+        u32 names_size = 0;
+        u32 reserved = 0;
+    } IndexFolderHeader;
+
+    typedef struct {
+        time_t mtime = 0;
+        std::vector<IndexEntry> entries;
+        std::string names;
+    } IndexFolder;
+
+    // Records are read and written through a buffer of this size rather than one fs call each.
+    static constexpr std::size_t chunk_size = 0x10000;
+
+    // One device's index is kept in memory, keyed by path so a folder's subtree is a contiguous range.
+    static std::recursive_mutex index_mutex;
+    static std::map<std::string, IndexFolder> folders;
+    static std::string index_device;
+    static bool complete = false, dirty = false;
+
+    static std::string GetIndexPath(const std::string &device) {
+        std::string name = device.substr(0, device.find(':'));
+        return "/switch/NX-Shell/index_" + name + ".bin";
+    }
+
+    static std::string GetChildPath(const std::string &path, const char *name) {
+        std::string child_path = path;
+        child_path.append((path.compare("/") == 0)? "" : "/");
+        child_path.append(name);
+        return child_path;
+    }
+
+    // Drops the folder and everything below it, "/a/" up to "/a0" covers exactly the paths under "/a".
+    static void EraseTree(const std::string &path) {
+        folders.erase(path);
+
+        const std::string prefix = (path.compare("/") == 0)? path : path + "/";
+        std::string end = prefix;
+        end.back()++;
+        folders.erase(folders.lower_bound(prefix), folders.lower_bound(end));
+    }
+
+    static void AddEntry(IndexFolder &folder, const char *name, u16 name_length, u8 type, s64 file_size, time_t modified) {
+        IndexEntry entry;
+        entry.file_size = file_size;
+        entry.modified = modified;
+        entry.name_offset = static_cast<u32>(folder.names.size());
+        entry.name_length = name_length;
+        entry.type = type;
+        entry.file_type = (type == FsDirEntryType_File)? FS::GetFileType(name) : FileTypeNone;
+
+        folder.names.append(name, name_length);
+        folder.names.push_back('\0');
+
+        for (u16 i = 0; i < name_length; i++)
+            folder.names.push_back(((name[i] >= 'A') && (name[i] <= 'Z'))? (name[i] + ('a' - 'A')) : name[i]);
+
+        folder.names.push_back('\0');
+        folder.entries.push_back(entry);
+    }
+
+    static bool FindEntry(const IndexFolder &folder, const char *name, std::size_t &index) {
+        for (std::size_t i = 0; i < folder.entries.size(); i++) {
+            if (std::strcmp(folder.names.data() + folder.entries[i].name_offset, name) == 0) {
+                index = i;
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    typedef struct {
+        FsFile file;
+        s64 offset = 0;
+        s64 size = 0;
+        std::vector<char> buffer;
+        std::size_t buffer_offset = 0;
+    } IndexFile;
+
+    static bool Read(IndexFile &index_file, void *data, std::size_t size) {
+        char *out = static_cast<char *>(data);
+
+        while (size > 0) {
+            if (index_file.buffer_offset == index_file.buffer.size()) {
+                Result ret = 0;
+                u64 bytes_read = 0;
+                std::size_t length = static_cast<std::size_t>(std::min<s64>(chunk_size, index_file.size - index_file.offset));
+
+                if (length == 0)
+                    return false;
+
+                index_file.buffer.resize(length);
+                if (R_FAILED(ret = fsFileRead(std::addressof(index_file.file), index_file.offset, index_file.buffer.data(), length, FsReadOption_None, std::addressof(bytes_read)))) {
+                    Log::Error("Index::Read fsFileRead() failed: 0x%x\n", ret);
+                    return false;
+                }
+
+                index_file.buffer.resize(bytes_read);
+                index_file.buffer_offset = 0;
+                index_file.offset += bytes_read;
+
+                if (bytes_read == 0)
+                    return false;
+            }
+
+            std::size_t length = std::min(size, index_file.buffer.size() - index_file.buffer_offset);
+            std::memcpy(out, index_file.buffer.data() + index_file.buffer_offset, length);
+            index_file.buffer_offset += length;
+            out += length;
+            size -= length;
+        }
+
+        return true;
+    }
+
+    static bool Flush(IndexFile &index_file) {
+        Result ret = 0;
+
+        if (index_file.buffer.empty())
+            return true;
+
+        if (R_FAILED(ret = fsFileWrite(std::addressof(index_file.file), index_file.offset, index_file.buffer.data(), index_file.buffer.size(), FsWriteOption_None))) {
+            Log::Error("Index::Flush fsFileWrite() failed: 0x%x\n", ret);
+            return false;
+        }
+
+        index_file.offset += index_file.buffer.size();
+        index_file.buffer.clear();
+        return true;
+    }
+
+    static bool Write(IndexFile &index_file, const void *data, std::size_t size) {
+        const char *in = static_cast<const char *>(data);
+
+        if ((index_file.buffer.size() + size > chunk_size) && (!Index::Flush(index_file)))
+            return false;
+
+        // Anything bigger than a chunk goes straight to the file
+        if (size > chunk_size) {
+            Result ret = 0;
+
+            if (R_FAILED(ret = fsFileWrite(std::addressof(index_file.file), index_file.offset, in, size, FsWriteOption_None))) {
+                Log::Error("Index::Write fsFileWrite() failed: 0x%x\n", ret);
+                return false;
+            }
+
+            index_file.offset += size;
+            return true;
+        }
+
+        index_file.buffer.insert(index_file.buffer.end(), in, in + size);
+        return true;
+    }
+
+    // What's left to read, so sizes from a damaged file get caught before they're used.
+    static s64 GetRemaining(const IndexFile &index_file) {
+        return (index_file.size - index_file.offset) + static_cast<s64>(index_file.buffer.size() - index_file.buffer_offset);
+    }
+
+    // Each name is followed by a NUL, its case-folded key and another NUL.
+    static bool IsValidEntry(const IndexFolder &folder, const IndexEntry &entry) {
+        const u64 end = static_cast<u64>(entry.name_offset) + (static_cast<u64>(entry.name_length) * 2) + 2;
+
+        return ((end <= folder.names.size()) && (folder.names[entry.name_offset + entry.name_length] == '\0') && (folder.names[end - 1] == '\0'));
+    }
+
+    static bool Load(const std::string &device) {
+        Result ret = 0;
+        const std::string path = Index::GetIndexPath(device);
+        IndexFile index_file;
+
+        if (R_FAILED(ret = fsFsOpenFile(std::addressof(devices[FileSystemSDMC]), path.c_str(), FsOpenMode_Read, std::addressof(index_file.file))))
+            return false;
+
+        if (R_FAILED(ret = fsFileGetSize(std::addressof(index_file.file), std::addressof(index_file.size)))) {
+            Log::Error("Index::Load fsFileGetSize(%s) failed: 0x%x\n", path.c_str(), ret);
+            fsFileClose(std::addressof(index_file.file));
+            return false;
+        }
+
+        IndexHeader header;
+        if ((!Index::Read(index_file, std::addressof(header), sizeof(header))) || (header.magic != INDEX_MAGIC) || (header.version != INDEX_VERSION)) {
+            fsFileClose(std::addressof(index_file.file));
+            return false;
+        }
+
+        bool ret_value = true;
+
+        for (u32 i = 0; i < header.folder_count; i++) {
+            IndexFolderHeader folder_header;
+            std::string folder_path;
+            IndexFolder folder;
+
+            if (!Index::Read(index_file, std::addressof(folder_header), sizeof(folder_header))) {
+                ret_value = false;
+                break;
+            }
+
+            const u64 folder_size = static_cast<u64>(folder_header.path_length) + (static_cast<u64>(folder_header.entry_count) * sizeof(IndexEntry)) + folder_header.names_size;
+            if (folder_size > static_cast<u64>(Index::GetRemaining(index_file))) {
+                ret_value = false;
+                break;
+            }
+
+            folder_path.resize(folder_header.path_length);
+            folder.entries.resize(folder_header.entry_count);
+            folder.names.resize(folder_header.names_size);
+            folder.mtime = folder_header.mtime;
+
+            if ((!Index::Read(index_file, folder_path.data(), folder_path.size())) ||
+                (!Index::Read(index_file, folder.entries.data(), folder.entries.size() * sizeof(IndexEntry))) ||
+                (!Index::Read(index_file, folder.names.data(), folder.names.size()))) {
+                ret_value = false;
+                break;
+            }
+
+            if (!std::all_of(folder.entries.begin(), folder.entries.end(), [&folder](const IndexEntry &entry) { return Index::IsValidEntry(folder, entry); })) {
+                ret_value = false;
+                break;
+            }
+
+            folders.emplace(std::move(folder_path), std::move(folder));
+        }
+
+        fsFileClose(std::addressof(index_file.file));
+
+        if (!ret_value) {
+            Log::Error("Index::Load(%s) index is truncated or damaged.\n", path.c_str());
+            folders.clear();
+        }
+
+        return ret_value;
+    }
+
+    // Loads the device's index for a search, returns false if it has to be built by walking the whole device.
+    // The index stays incomplete until End(), so a cancelled refresh gets reloaded from the last saved one.
+    bool Begin(const std::string &device) {
+        std::scoped_lock lock(index_mutex);
+
+        if ((index_device != device) || (!complete)) {
+            Index::Save();
+
+            folders.clear();
+            index_device = device;
+            complete = Index::Load(device);
+            dirty = false;
+        }
+
+        const bool loaded = complete;
+        complete = false;
+        return loaded;
+    }
+
+    void End(void) {
+        std::scoped_lock lock(index_mutex);
+        complete = true;
+        Index::Save();
+    }
+
+    void Find(const std::vector<std::string> &tokens, std::vector<SearchResult> &results) {
+        std::scoped_lock lock(index_mutex);
+
+        for (const auto &[path, folder] : folders) {
+            for (const IndexEntry &index_entry : folder.entries) {
+                DirEntry entry;
+                entry.name = folder.names.data() + index_entry.name_offset;
+                entry.name_length = index_entry.name_length;
+
+                if (FileBrowser::MatchEntry(entry, tokens))
+                    results.push_back({ path, entry.name, index_entry.type, index_entry.file_type });
+            }
+        }
+    }
+
+    void GetFolders(std::vector<std::string> &paths) {
+        std::scoped_lock lock(index_mutex);
+        paths.reserve(folders.size());
+
+        for (const auto &[path, folder] : folders)
+            paths.push_back(path);
+    }
+
+    time_t GetFolderTime(const std::string &path) {
+        std::scoped_lock lock(index_mutex);
+
+        auto folder = folders.find(path);
+        return (folder != folders.end())? folder->second.mtime : 0;
+    }
+
+    bool HasFolder(const std::string &path) {
+        std::scoped_lock lock(index_mutex);
+        return (folders.find(path) != folders.end());
+    }
+
+    // Replaces a folder's entries with a fresh listing. added gets the entries that weren't indexed
+    // before and removed the paths of the ones that are gone. Subfolders that are gone get dropped
+    // along with everything below them.
+    void SetFolder(const std::string &path, time_t mtime, const DirListing &entries, std::vector<const DirEntry *> &added, std::vector<std::string> &removed) {
+        std::scoped_lock lock(index_mutex);
+        IndexFolder &old_folder = folders[path];
+        IndexFolder folder;
+        folder.mtime = mtime;
+        folder.entries.reserve(entries.size());
+
+        std::unordered_set<std::string_view> old_names, names;
+        for (const IndexEntry &old_entry : old_folder.entries)
+            old_names.emplace(old_folder.names.data() + old_entry.name_offset, old_entry.name_length);
+
+        for (const DirEntry &entry : entries) {
+            if (old_names.find(std::string_view(entry.name, entry.name_length)) == old_names.end())
+                added.push_back(std::addressof(entry));
+
+            names.emplace(entry.name, entry.name_length);
+            Index::AddEntry(folder, entry.name, entry.name_length, entry.type, entry.file_size, entry.modified);
+        }
+
+        for (const IndexEntry &old_entry : old_folder.entries) {
+            const char *name = old_folder.names.data() + old_entry.name_offset;
+
+            if (names.find(std::string_view(name, old_entry.name_length)) != names.end())
+                continue;
+            
+            removed.push_back(Index::GetChildPath(path, name));
+
+            if (old_entry.type == FsDirEntryType_Dir)
+                Index::EraseTree(removed.back());
+        }
+
+        folders[path] = std::move(folder);
+        dirty = true;
+    }
+
+    void RemoveFolder(const std::string &path) {
+        std::scoped_lock lock(index_mutex);
+        Index::EraseTree(path);
+        dirty = true;
+    }
+
+    // File operations keep the loaded index up to date, so it doesn't depend on the filesystem updating folder mtimes.
+    void EntryAdded(const std::string &device, const std::string &path, const DirEntry &entry) {
+        std::scoped_lock lock(index_mutex);
+
+        auto folder = folders.find(path);
+        if ((device != index_device) || (folder == folders.end()))
+            return;
+
+        std::size_t index = 0;
+        if (Index::FindEntry(folder->second, entry.name, index))
+            folder->second.entries.erase(folder->second.entries.begin() + index);
+
+        Index::AddEntry(folder->second, entry.name, entry.name_length, entry.type, entry.file_size, entry.modified);
+
+        // A new folder's contents are read on the next refresh, a zero mtime never matches.
+        if (entry.type == FsDirEntryType_Dir)
+            folders.emplace(Index::GetChildPath(path, entry.name), IndexFolder());
+
+        dirty = true;
+    }
+
+    void EntryRemoved(const std::string &device, const std::string &path, const DirEntry &entry) {
+        std::scoped_lock lock(index_mutex);
+
+        auto folder = folders.find(path);
+        if ((device != index_device) || (folder == folders.end()))
+            return;
+
+        std::size_t index = 0;
+        if (Index::FindEntry(folder->second, entry.name, index))
+            folder->second.entries.erase(folder->second.entries.begin() + index);
+
+        if (entry.type == FsDirEntryType_Dir)
+            Index::EraseTree(Index::GetChildPath(path, entry.name));
+
+        dirty = true;
+    }
+
+    // Makes the next refresh read the folder again, for changes we couldn't apply entry by entry.
+    void Invalidate(const std::string &device, const std::string &path) {
+        std::scoped_lock lock(index_mutex);
+
+        auto folder = folders.find(path);
+        if ((device != index_device) || (folder == folders.end()))
+            return;
+
+        folder->second.mtime = 0;
+        dirty = true;
+    }
+
+    // Only complete indexes with changes get saved. Written to a temporary file first, so a failed save never leaves a broken index behind.
+    void Save(void) {
+        std::scoped_lock lock(index_mutex);
+
+        if ((index_device.empty()) || (!complete) || (!dirty))
+            return;
+
+        Result ret = 0;
+        const std::string path = Index::GetIndexPath(index_device), temp_path = path + ".tmp";
+        IndexFile index_file;
+        IndexHeader header;
+        header.folder_count = static_cast<u32>(folders.size());
+
+        s64 size = sizeof(IndexHeader);
+        for (const auto &[folder_path, folder] : folders)
+            size += sizeof(IndexFolderHeader) + folder_path.length() + (folder.entries.size() * sizeof(IndexEntry)) + folder.names.size();
+
+        fsFsDeleteFile(std::addressof(devices[FileSystemSDMC]), temp_path.c_str());
+        if (R_FAILED(ret = fsFsCreateFile(std::addressof(devices[FileSystemSDMC]), temp_path.c_str(), size, 0))) {
+            Log::Error("Index::Save fsFsCreateFile(%s) failed: 0x%x\n", temp_path.c_str(), ret);
+            return;
+        }
+
+        if (R_FAILED(ret = fsFsOpenFile(std::addressof(devices[FileSystemSDMC]), temp_path.c_str(), FsOpenMode_Write, std::addressof(index_file.file)))) {
+            Log::Error("Index::Save fsFsOpenFile(%s) failed: 0x%x\n", temp_path.c_str(), ret);
+            return;
+        }
+
+        bool ret_value = Index::Write(index_file, std::addressof(header), sizeof(header));
+
+        for (const auto &[folder_path, folder] : folders) {
+            if (!ret_value)
+                break;
+
+            IndexFolderHeader folder_header;
+            folder_header.mtime = folder.mtime;
+            folder_header.path_length = static_cast<u32>(folder_path.length());
+            folder_header.entry_count = static_cast<u32>(folder.entries.size());
+            folder_header.names_size = static_cast<u32>(folder.names.size());
+
+            ret_value = (Index::Write(index_file, std::addressof(folder_header), sizeof(folder_header))) &&
+                (Index::Write(index_file, folder_path.data(), folder_path.length())) &&
+                (Index::Write(index_file, folder.entries.data(), folder.entries.size() * sizeof(IndexEntry))) &&
+                (Index::Write(index_file, folder.names.data(), folder.names.size()));
+        }
+
+        ret_value = (ret_value) && (Index::Flush(index_file));
+        fsFileClose(std::addressof(index_file.file));
+
+        if (!ret_value) {
+            fsFsDeleteFile(std::addressof(devices[FileSystemSDMC]), temp_path.c_str());
+            return;
+        }
+
+        fsFsDeleteFile(std::addressof(devices[FileSystemSDMC]), path.c_str());
+        if (R_FAILED(ret = fsFsRenameFile(std::addressof(devices[FileSystemSDMC]), temp_path.c_str(), path.c_str()))) {
+            Log::Error("Index::Save fsFsRenameFile(%s) failed: 0x%x\n", temp_path.c_str(), ret);
+            return;
+        }
+
+        dirty = false;
+    }
+}
@@ -0,0 +1,253 @@
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "fs.hpp"
+#include "journal.hpp"
+#include "log.hpp"
+#include "utils.hpp"
+
+#define JOURNAL_MAGIC   0x4A53584E // "NXSJ"
+#define JOURNAL_VERSION 2
+
+namespace Journal {
+    // The job the journal belongs to, followed by its source and destination path.
+    typedef struct {
+        u32 magic = JOURNAL_MAGIC;
+        u32 version = JOURNAL_VERSION;
+        u32 src_length = 0;
+        u32 dest_length = 0;
+        u8 type = FsDirEntryType_File;
+        u8 reserved[7] = { 0 };
+    } JournalHeader;
+
+    // Records are appended after the header, each followed by its destination path. The crc covers the rest
+    // of the record and the path, so one that was only partly written when we got cut off is dropped.
+    // The source's size and modification time are kept so a record for a file that's since changed is ignored.
+    typedef struct {
+        u32 crc = 0;
+        u32 path_length = 0;
+        s64 offset = 0;
+        s64 src_size = 0;
+        u64 src_mtime = 0;
+        u8 done = 0;
+        u8 reserved[7] = { 0 };
+    } JournalRecord;
+
+    // Each job gets its own journal, named after a hash of its source and destination, so pasting something
+    // else doesn't throw away what an earlier copy left to be resumed.
+    static char journal_path[FS_MAX_PATH];
+
+    // Finished files are written out in batches of about this size. Losing the last batch only means
+    // copying those files again, so they don't get a flush each, offsets do.
+    static constexpr std::size_t batch_size = 0x1000;
+
+    // Only the job the transfer thread is working on is journalled, files finished by the small file
+    // workers are recorded from their threads as well.
+    static std::mutex journal_mutex;
+    static FsFile file;
+    static s64 file_offset = 0;
+    static bool file_open = false;
+    static std::string pending;
+    static std::unordered_map<std::string, JournalRecord> records;
+
+    static u32 GetRecordCRC(const JournalRecord &record, const char *path) {
+        u32 crc = Utils::CRC32C(0, reinterpret_cast<const u8 *>(std::addressof(record)) + sizeof(record.crc), sizeof(record) - sizeof(record.crc));
+        return Utils::CRC32C(crc, path, record.path_length);
+    }
+
+    // Picks up the records of an unfinished copy of the same job, and returns how far into the file they're valid.
+    static s64 Load(const std::string &src_path, const std::string &dest_path, u8 type) {
+        Result ret = 0;
+        s64 size = 0;
+
+        if (R_FAILED(ret = fsFileGetSize(std::addressof(file), std::addressof(size))))
+            return 0;
+
+        std::vector<char> buf(size);
+        u64 bytes_read = 0;
+
+        if (R_FAILED(ret = fsFileRead(std::addressof(file), 0, buf.data(), buf.size(), FsReadOption_None, std::addressof(bytes_read)))) {
+            Log::Error("Journal::Load fsFileRead() failed: 0x%x\n", ret);
+            return 0;
+        }
+
+        JournalHeader header;
+        if (bytes_read < sizeof(header))
+            return 0;
+
+        std::memcpy(std::addressof(header), buf.data(), sizeof(header));
+        s64 offset = sizeof(header) + header.src_length + header.dest_length;
+
+        if ((header.magic != JOURNAL_MAGIC) || (header.version != JOURNAL_VERSION) || (header.type != type) || (static_cast<u64>(offset) > bytes_read) ||
+            (src_path.compare(0, std::string::npos, buf.data() + sizeof(header), header.src_length) != 0) ||
+            (dest_path.compare(0, std::string::npos, buf.data() + sizeof(header) + header.src_length, header.dest_length) != 0))
+            return 0;
+
+        while (offset + static_cast<s64>(sizeof(JournalRecord)) <= static_cast<s64>(bytes_read)) {
+            JournalRecord record;
+            std::memcpy(std::addressof(record), buf.data() + offset, sizeof(record));
+
+            const char *path = buf.data() + offset + sizeof(record);
+            if ((offset + static_cast<s64>(sizeof(record) + record.path_length) > static_cast<s64>(bytes_read)) || (record.crc != Journal::GetRecordCRC(record, path)))
+                break;
+
+            // A later record for the same file replaces the earlier one
+            records[std::string(path, record.path_length)] = record;
+            offset += sizeof(record) + record.path_length;
+        }
+
+        return offset;
+    }
+
+    static bool Append(const void *data, std::size_t size, FsWriteOption option) {
+        Result ret = 0;
+
+        if (R_FAILED(ret = fsFileWrite(std::addressof(file), file_offset, data, size, option))) {
+            Log::Error("Journal::Append fsFileWrite() failed: 0x%x\n", ret);
+            return false;
+        }
+
+        file_offset += size;
+        return true;
+    }
+
+    static void Flush(FsWriteOption option) {
+        if ((!file_open) || (pending.empty()))
+            return;
+
+        if (!Journal::Append(pending.data(), pending.size(), option)) {
+            fsFileClose(std::addressof(file));
+            file_open = false;
+        }
+
+        pending.clear();
+    }
+
+    // The record is kept whether or not the journal could be opened, so the rest of this run still sees it.
+    static void AddRecord(const std::string &path, const Source &source, s64 offset, bool is_done) {
+        JournalRecord &record = records[path];
+        record.path_length = static_cast<u32>(path.length());
+        record.offset = offset;
+        record.src_size = source.size;
+        record.src_mtime = source.mtime;
+        record.done = is_done;
+        record.crc = Journal::GetRecordCRC(record, path.c_str());
+
+        if (!file_open)
+            return;
+
+        pending.append(reinterpret_cast<const char *>(std::addressof(record)), sizeof(record));
+        pending.append(path);
+
+        // An offset only counts once it's on the card
+        if ((!is_done) || (pending.size() >= batch_size))
+            Journal::Flush(is_done? FsWriteOption_None : FsWriteOption_Flush);
+    }
+
+    // Starts journalling a job. Returns true if an unfinished copy of the same job was left behind,
+    // its finished files and the offset reached in the one that was in progress are picked up.
+    bool Begin(const std::string &src_path, const std::string &dest_path, u8 type) {
+        std::scoped_lock lock(journal_mutex);
+        Result ret = 0;
+        FsFileSystem *sdmc = std::addressof(devices[FileSystemSDMC]);
+
+        u32 hash = Utils::CRC32C(0, src_path.c_str(), src_path.length() + 1);
+        hash = Utils::CRC32C(hash, dest_path.c_str(), dest_path.length());
+        std::snprintf(journal_path, FS_MAX_PATH, "/switch/NX-Shell/transfer_journal_%08X.bin", hash);
+
+        records.clear();
+        pending.clear();
+        file_offset = 0;
+        file_open = false;
+
+        if (R_SUCCEEDED(fsFsOpenFile(sdmc, journal_path, FsOpenMode_Read | FsOpenMode_Write | FsOpenMode_Append, std::addressof(file)))) {
+            // Anything after the last whole record is cut off, so new records follow straight on
+            if (((file_offset = Journal::Load(src_path, dest_path, type)) != 0) && (R_SUCCEEDED(fsFileSetSize(std::addressof(file), file_offset)))) {
+                file_open = true;
+                return true;
+            }
+
+            fsFileClose(std::addressof(file));
+            records.clear();
+            file_offset = 0;
+        }
+
+        // One that didn't load, or belongs to another job with the same hash, is started over
+        fsFsDeleteFile(sdmc, journal_path);
+
+        if (R_FAILED(ret = fsFsCreateFile(sdmc, journal_path, 0, 0))) {
+            Log::Error("Journal::Begin fsFsCreateFile(%s) failed: 0x%x\n", journal_path, ret);
+            return false;
+        }
+
+        if (R_FAILED(ret = fsFsOpenFile(sdmc, journal_path, FsOpenMode_Write | FsOpenMode_Append, std::addressof(file)))) {
+            Log::Error("Journal::Begin fsFsOpenFile(%s) failed: 0x%x\n", journal_path, ret);
+            return false;
+        }
+
+        JournalHeader header;
+        header.src_length = static_cast<u32>(src_path.length());
+        header.dest_length = static_cast<u32>(dest_path.length());
+        header.type = type;
+
+        std::string buf(reinterpret_cast<const char *>(std::addressof(header)), sizeof(header));
+        buf.append(src_path);
+        buf.append(dest_path);
+
+        file_open = Journal::Append(buf.data(), buf.size(), FsWriteOption_Flush);
+        if (!file_open)
+            fsFileClose(std::addressof(file));
+
+        return false;
+    }
+
+    // The journal is only kept if the job didn't finish, so the next paste of it can pick up from there.
+    void End(bool finished) {
+        std::scoped_lock lock(journal_mutex);
+
+        if (file_open) {
+            Journal::Flush(FsWriteOption_Flush);
+            fsFileClose(std::addressof(file));
+            file_open = false;
+        }
+
+        if (finished)
+            fsFsDeleteFile(std::addressof(devices[FileSystemSDMC]), journal_path);
+
+        records.clear();
+    }
+
+    static const JournalRecord *GetRecord(const std::string &path, const Source &source) {
+        auto record = records.find(path);
+        if ((record == records.end()) || (record->second.src_size != source.size) || (record->second.src_mtime != source.mtime))
+            return nullptr;
+        
+        return std::addressof(record->second);
+    }
+
+    bool IsDone(const std::string &path, const Source &source) {
+        std::scoped_lock lock(journal_mutex);
+        const JournalRecord *record = Journal::GetRecord(path, source);
+        return ((record) && (record->done));
+    }
+
+    s64 GetOffset(const std::string &path, const Source &source) {
+        std::scoped_lock lock(journal_mutex);
+        const JournalRecord *record = Journal::GetRecord(path, source);
+        return ((record) && (!record->done))? record->offset : 0;
+    }
+
+    // Called once everything up to offset has been flushed to the destination.
+    void SetOffset(const std::string &path, const Source &source, s64 offset) {
+        std::scoped_lock lock(journal_mutex);
+        Journal::AddRecord(path, source, offset, false);
+    }
+
+    void SetDone(const std::string &path, const Source &source) {
+        std::scoped_lock lock(journal_mutex);
+        Journal::AddRecord(path, source, 0, true);
+    }
+}
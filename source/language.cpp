@@ -31,6 +31,7 @@ static const char *strings_jp[] {
     "Accessed: ",
     "Width: ",
     "Height: ",
+    "Contains: %lu files, %lu folders",
 
     "This action cannot be undone.",
     "Do you wish to delete the following:",
@@ -54,6 +55,9 @@ static const char *strings_jp[] {
     " Display filename",
     " Enable logs",
     " Enable support for special symbols/characters",
+    " Natural order (file2 before file10)",
+    "Copy Settings",
+    " Don't verify copies",
     "version",
     "Author",
     "Banner",
@@ -69,7 +73,17 @@ static const char *strings_jp[] {
     "Do you wish to unmount all the connected USB devices?",
     "The USB device can now be safely removed.",
 
-    "The name cannot be empty."
+    "The name cannot be empty.",
+
+    "Filter",
+    "Enter text to filter by",
+    "Clear",
+
+    "Search",
+    "Enter a file name to search for",
+    "%lu results in %lu folders",
+
+    "%s/s, %.1f files/s, %lu:%02lu:%02lu left"
 };
 
 static const char *strings_en[] {
@@ -100,6 +114,7 @@ static const char *strings_en[] {
     "Accessed: ",
     "Width: ",
     "Height: ",
+    "Contains: %lu files, %lu folders",
 
     "This action cannot be undone.",
     "Do you wish to delete the following:",
@@ -123,6 +138,9 @@ static const char *strings_en[] {
     " Display filename",
     " Enable logs",
     " Enable support for special symbols/characters",
+    " Natural order (file2 before file10)",
+    "Copy Settings",
+    " Don't verify copies",
     "version",
     "Author",
     "Banner",
@@ -138,7 +156,17 @@ static const char *strings_en[] {
     "Do you wish to unmount all the connected USB devices?",
     "The USB device can now be safely removed.",
 
-    "The name cannot be empty."
+    "The name cannot be empty.",
+
+    "Filter",
+    "Enter text to filter by",
+    "Clear",
+
+    "Search",
+    "Enter a file name to search for",
+    "%lu results in %lu folders",
+
+    "%s/s, %.1f files/s, %lu:%02lu:%02lu left"
 };
 
 // TODO: French
@@ -170,6 +198,7 @@ static const char *strings_fr[] {
     "Accessed: ",
     "Width: ",
     "Height: ",
+    "Contains: %lu files, %lu folders",
 
     "This action cannot be undone.",
     "Do you wish to delete the following:",
@@ -193,6 +222,9 @@ static const char *strings_fr[] {
     " Display filename",
     " Enable logs",
     " Enable support for special symbols/characters",
+    " Natural order (file2 before file10)",
+    "Copy Settings",
+    " Don't verify copies",
     "version",
     "Author",
     "Banner",
@@ -208,7 +240,17 @@ static const char *strings_fr[] {
     "Do you wish to unmount all the connected USB devices?",
     "The USB device can now be safely removed.",
 
-    "The name cannot be empty."
+    "The name cannot be empty.",
+
+    "Filter",
+    "Enter text to filter by",
+    "Clear",
+
+    "Search",
+    "Enter a file name to search for",
+    "%lu results in %lu folders",
+
+    "%s/s, %.1f files/s, %lu:%02lu:%02lu left"
 };
 
 static const char *strings_de[] {
@@ -239,6 +281,7 @@ static const char *strings_de[] {
     "Zugegriffen: ",
     "Breite: ",
     "Höhe: ",
+    "Contains: %lu files, %lu folders",
 
     "Dies kann nicht rückgängig gemacht werden.",
     "Möchten Sie Folgendes löschen:",
@@ -262,6 +305,9 @@ static const char *strings_de[] {
     " Dateiname anzeigen",
     " Log aktivieren",
     " Enable support for special symbols/characters",
+    " Natural order (file2 before file10)",
+    "Copy Settings",
+    " Don't verify copies",
     "Version",
     "Autor",
     "Banner",
@@ -277,7 +323,17 @@ static const char *strings_de[] {
     "Do you wish to unmount all the connected USB devices?",
     "The USB device can now be safely removed.",
 
-    "Der Name darf nicht leer sein."
+    "Der Name darf nicht leer sein.",
+
+    "Filter",
+    "Enter text to filter by",
+    "Clear",
+
+    "Search",
+    "Enter a file name to search for",
+    "%lu results in %lu folders",
+
+    "%s/s, %.1f files/s, %lu:%02lu:%02lu left"
 };
 
 // TODO: Italian
@@ -309,6 +365,7 @@ static const char *strings_it[] {
     "Accessed: ",
     "Width: ",
     "Height: ",
+    "Contains: %lu files, %lu folders",
 
     "This action cannot be undone.",
     "Do you wish to delete the following:",
@@ -332,6 +389,9 @@ static const char *strings_it[] {
     " Display filename",
     " Enable logs",
     " Enable support for special symbols/characters",
+    " Natural order (file2 before file10)",
+    "Copy Settings",
+    " Don't verify copies",
     "version",
     "Author",
     "Banner",
@@ -347,7 +407,17 @@ static const char *strings_it[] {
     "Do you wish to unmount all the connected USB devices?",
     "The USB device can now be safely removed.",
 
-    "The name cannot be empty."
+    "The name cannot be empty.",
+
+    "Filter",
+    "Enter text to filter by",
+    "Clear",
+
+    "Search",
+    "Enter a file name to search for",
+    "%lu results in %lu folders",
+
+    "%s/s, %.1f files/s, %lu:%02lu:%02lu left"
 };
 
 //  Spanish
@@ -379,6 +449,7 @@ static const char *strings_es[] {
     "Accedido: ",
     "Ancho: ",
     "Alto: ",
+    "Contains: %lu files, %lu folders",
 
     "Esta acción no se puede deshacer.",
     "Deseas eliminar lo siguiente:",
@@ -402,6 +473,9 @@ static const char *strings_es[] {
     " Mostrar nombre de archivo",
     " Habilitar logs",
     " Enable support for special symbols/characters",
+    " Natural order (file2 before file10)",
+    "Copy Settings",
+    " Don't verify copies",
     "versión",
     "Autor",
     "Banner",
@@ -417,7 +491,17 @@ static const char *strings_es[] {
     "¿Quieres desmontar todos los dispositivos USB conectados?",
     "El dispositivo USB ahora puede ser removido de forma segura.",
 
-    "El nombre no puede estar vacío."
+    "El nombre no puede estar vacío.",
+
+    "Filter",
+    "Enter text to filter by",
+    "Clear",
+
+    "Search",
+    "Enter a file name to search for",
+    "%lu results in %lu folders",
+
+    "%s/s, %.1f files/s, %lu:%02lu:%02lu left"
 };
 
 // Simplified Chinese ("Chinese")
@@ -449,6 +533,7 @@ static const char *strings_sc[] {
     "最后访问: ",
     "宽度: ",
     "高度: ",
+    "Contains: %lu files, %lu folders",
 
     "本操作不可逆.",
     "确定删除下列文件吗:",
@@ -472,6 +557,9 @@ static const char *strings_sc[] {
     " 显示文件名",
     " 打开日志",
     " 启用对特殊符号/字符的支持",
+    " Natural order (file2 before file10)",
+    "Copy Settings",
+    " Don't verify copies",
     "版本",
     "作者",
     "横幅",
@@ -487,7 +575,17 @@ static const char *strings_sc[] {
     "您想卸载所有连接的 USB 设备吗？",
     "现在可以安全地移除 USB 设备。",
 
-    "名称不能为空."
+    "名称不能为空.",
+
+    "Filter",
+    "Enter text to filter by",
+    "Clear",
+
+    "Search",
+    "Enter a file name to search for",
+    "%lu results in %lu folders",
+
+    "%s/s, %.1f files/s, %lu:%02lu:%02lu left"
 };
 
 // TODO: Korean
@@ -519,6 +617,7 @@ static const char *strings_ko[] {
     "접속: ",
     "너비: ",
     "높이: ",
+    "Contains: %lu files, %lu folders",
 
     "이 작업은 취소할 수 없습니다.",
     "다음을 삭제하겠습니까:",
@@ -542,6 +641,9 @@ static const char *strings_ko[] {
     " 파일 이름 표시",
     " 로그 활성화",
     " 특수 기호/문자 지원 활성화",
+    " Natural order (file2 before file10)",
+    "Copy Settings",
+    " Don't verify copies",
     "버전",
     "제작자",
     "배너",
@@ -557,7 +659,17 @@ static const char *strings_ko[] {
     "연결된 모든 USB 장치를 마운트 해제하겠습니까?",
     "이제 USB 장치를 안전하게 제거할 수 있습니다.",
 
-    "이름은 공백이 될 수 없습니다."
+    "이름은 공백이 될 수 없습니다.",
+
+    "Filter",
+    "Enter text to filter by",
+    "Clear",
+
+    "Search",
+    "Enter a file name to search for",
+    "%lu results in %lu folders",
+
+    "%s/s, %.1f files/s, %lu:%02lu:%02lu left"
 };
 
 // TODO: Dutch
@@ -589,6 +701,7 @@ static const char *strings_nl[] {
     "Accessed: ",
     "Width: ",
     "Height: ",
+    "Contains: %lu files, %lu folders",
 
     "This action cannot be undone.",
     "Do you wish to delete the following:",
@@ -612,6 +725,9 @@ static const char *strings_nl[] {
     " Display filename",
     " Enable logs",
     " Enable support for special symbols/characters",
+    " Natural order (file2 before file10)",
+    "Copy Settings",
+    " Don't verify copies",
     "version",
     "Author",
     "Banner",
@@ -627,7 +743,17 @@ static const char *strings_nl[] {
     "Do you wish to unmount all the connected USB devices?",
     "The USB device can now be safely removed.",
 
-    "The name cannot be empty."
+    "The name cannot be empty.",
+
+    "Filter",
+    "Enter text to filter by",
+    "Clear",
+
+    "Search",
+    "Enter a file name to search for",
+    "%lu results in %lu folders",
+
+    "%s/s, %.1f files/s, %lu:%02lu:%02lu left"
 };
 
 // Portuguese
@@ -659,6 +785,7 @@ static const char *strings_pt[] {
     "Acessado: ",
     "Largura: ",
     "Altura: ",
+    "Contains: %lu files, %lu folders",
 
     "Essa ação não pode ser desfeita.",
     "Você deseja deletar os seguintes:",
@@ -682,6 +809,9 @@ static const char *strings_pt[] {
     " Exibir nome de arquivo",
     " Habilitar logs",
     " Habilitar suporte para símbolos/caracteres especiais",
+    " Natural order (file2 before file10)",
+    "Copy Settings",
+    " Don't verify copies",
     "versão",
     "Autor",
     "Banner",
@@ -697,7 +827,17 @@ static const char *strings_pt[] {
     "Você deseja desmontar todos os dispositivos USB conectados?",
     "O dispositivo USB pode ser removido com segurança.",
 
-    "O nome não pode estar vazio."
+    "O nome não pode estar vazio.",
+
+    "Filter",
+    "Enter text to filter by",
+    "Clear",
+
+    "Search",
+    "Enter a file name to search for",
+    "%lu results in %lu folders",
+
+    "%s/s, %.1f files/s, %lu:%02lu:%02lu left"
 };
 
 // TODO: Russian
@@ -729,6 +869,7 @@ static const char *strings_ru[] {
     "Accessed: ",
     "Width: ",
     "Height: ",
+    "Contains: %lu files, %lu folders",
 
     "This action cannot be undone.",
     "Do you wish to delete the following:",
@@ -752,6 +893,9 @@ static const char *strings_ru[] {
     " Display filename",
     " Enable logs",
     " Enable support for special symbols/characters",
+    " Natural order (file2 before file10)",
+    "Copy Settings",
+    " Don't verify copies",
     "version",
     "Author",
     "Banner",
@@ -767,7 +911,17 @@ static const char *strings_ru[] {
     "Do you wish to unmount all the connected USB devices?",
     "The USB device can now be safely removed.",
 
-    "The name cannot be empty."
+    "The name cannot be empty.",
+
+    "Filter",
+    "Enter text to filter by",
+    "Clear",
+
+    "Search",
+    "Enter a file name to search for",
+    "%lu results in %lu folders",
+
+    "%s/s, %.1f files/s, %lu:%02lu:%02lu left"
 };
 
 // Traditional Chinese ("Taiwanese")
@@ -799,6 +953,7 @@ static const char *strings_tw[] {
     "最後訪問: ",
     "寬度: ",
     "高度: ",
+    "Contains: %lu files, %lu folders",
 
     "本操作不可逆.",
     "確定刪除下列文件嗎:",
@@ -822,6 +977,9 @@ static const char *strings_tw[] {
     " 顯示文件名",
     " 打開日誌",
     " 啟用對特殊符號/字符的支持",
+    " Natural order (file2 before file10)",
+    "Copy Settings",
+    " Don't verify copies",
     "版本",
     "作者",
     "橫幅",
@@ -837,7 +995,17 @@ static const char *strings_tw[] {
     "您想卸載所有連接的 USB 設備嗎？",
     "現在可以安全地移除 USB 設備。",
 
-    "名稱不能為空."
+    "名稱不能為空.",
+
+    "Filter",
+    "Enter text to filter by",
+    "Clear",
+
+    "Search",
+    "Enter a file name to search for",
+    "%lu results in %lu folders",
+
+    "%s/s, %.1f files/s, %lu:%02lu:%02lu left"
 };
 
 const char **strings[Lang::Max] = {
@@ -2,11 +2,16 @@
 #include <switch.h>
 
 #include "config.hpp"
+#include "dirlist.hpp"
+#include "dirsize.hpp"
 #include "fs.hpp"
 #include "gui.hpp"
 #include "imgui.h"
+#include "index.hpp"
 #include "log.hpp"
+#include "search.hpp"
 #include "textures.hpp"
+#include "transfer.hpp"
 #include "windows.hpp"
 #include "usb.hpp"
 
@@ -81,20 +86,24 @@ int main(int argc, char* argv[]) {
 
     Services::Init();
 
-    if (!FS::GetDirList(device, cwd, data.entries)) {
+    if (!DirList::Start(device, cwd, data.entries)) {
         Services::Exit();
         return 0;
     }
     
-    data.checkbox_data.checked.resize(data.entries.size());
     FS::GetUsedStorageSpace(data.used_storage);
     FS::GetTotalStorageSpace(data.total_storage);
     
     while (GUI::Loop(key)) {
-        Windows::MainWindow(data, key, false);
+        Windows::MainWindow(data, key);
         GUI::Render();
     }
 
+    DirList::Cancel();
+    DirSize::Cancel();
+    Search::Cancel();
+    Transfer::Exit();
+    Index::Save();
     data.entries.clear();
     Services::Exit();
     return 0;
@@ -1,5 +1,5 @@
-#include <algorithm>
 #include <cstring>
+#include <vector>
 
 #include "config.hpp"
 #include "fs.hpp"
@@ -14,14 +14,14 @@ namespace Popups {
         
         if (ImGui::BeginPopupModal(strings[cfg.lang][Lang::OptionsDelete], nullptr, ImGuiWindowFlags_AlwaysAutoResize)) {
             ImGui::Text(strings[cfg.lang][Lang::DeleteMessage]);
-            if ((data.checkbox_data.count > 1) && (data.checkbox_data.cwd == cwd)) {
+            const bool multiple = ((data.checkbox_data.checked.size() > 1) && (data.checkbox_data.cwd == cwd) && (data.checkbox_data.device == device));
+
+            if (multiple) {
                 ImGui::Text(strings[cfg.lang][Lang::DeleteMultiplePrompt]);
                 ImGui::Dummy(ImVec2(0.0f, 5.0f)); // Spacing
                 ImGui::BeginChild("Scrolling", ImVec2(0, 100));
-                for (std::size_t i = 0; i < data.checkbox_data.checked.size(); i++) {
-                    if (data.checkbox_data.checked[i])
-                        ImGui::Text(data.entries[i].name);
-                }
+                for (const auto &[name, type] : data.checkbox_data.checked)
+                    ImGui::TextUnformatted(name.c_str());
                 ImGui::EndChild();
             }
             else {
@@ -34,38 +34,38 @@ namespace Popups {
             if (ImGui::Button(strings[cfg.lang][Lang::ButtonOK], ImVec2(120, 0))) {
                 bool ret = false;
 
-                if ((data.checkbox_data.count > 1) && (data.checkbox_data.cwd == cwd)) {
-                    std::vector<FsDirectoryEntry> entries;
-                    if (!FS::GetDirList(data.checkbox_data.device, data.checkbox_data.cwd, entries))
-                        return;
-                        
-                    std::sort(entries.begin(), entries.end(), FileBrowser::Sort);
+                if (multiple) {
+                    // The checked entries are in the current directory, one pass over the listing finds them all
+                    std::vector<DirEntry> deleted;
                     Log::Exit();
 
-                    for (std::size_t i = 0; i < data.checkbox_data.checked.size(); i++) {
-                        if (std::strncmp(entries[i].name, "..", 2) == 0)
+                    for (DirEntry &entry : data.entries) {
+                        if (entry.flags & DirEntryFlagParent)
                             continue;
                         
-                        if (data.checkbox_data.checked[i]) {
-                            if (!(ret = FS::Delete(entries[i]))) {
-                                FS::GetDirList(device, cwd, data.entries);
-                                Windows::ResetCheckbox(data);
+                        if (Windows::IsChecked(data, entry)) {
+                            if (!(ret = FS::Delete(entry)))
                                 break;
-                            }
+                            
+                            deleted.push_back(entry);
                         }
                     }
+
+                    // Even if one failed, the ones deleted before it are gone
+                    FileBrowser::RemoveEntries(data, deleted);
+                    
+                    Windows::ResetCheckbox(data);
                 }
                 else {
-                    if ((std::strncmp(data.entries[data.selected].name, "..", 2)) != 0)
+                    if (!(data.entries[data.selected].flags & DirEntryFlagParent))
                         ret = FS::Delete(data.entries[data.selected]);
+                    
+                    if (ret) {
+                        FileBrowser::RemoveEntry(data, data.entries[data.selected]);
+                        Windows::ResetCheckbox(data);
+                    }
                 }
                 
-                if (ret) {
-                    FS::GetDirList(device, cwd, data.entries);
-                    Windows::ResetCheckbox(data);
-                }
-
-                sort = -1;
                 Log::Init();
                 ImGui::CloseCurrentPopup();
                 data.state = WINDOW_STATE_FILEBROWSER;
@@ -1,68 +1,82 @@
 #include <algorithm>
 #include <cstring>
+#include <filesystem>
 #include <glad/glad.h>
 #include <sys/stat.h>
 
 #include "config.hpp"
+#include "dirlist.hpp"
 #include "fs.hpp"
 #include "gui.hpp"
 #include "imgui_impl_switch.hpp"
 #include "imgui_internal.h"
+#include "index.hpp"
 #include "keyboard.hpp"
 #include "language.hpp"
 #include "popups.hpp"
 
 namespace Options {
     static void RefreshEntries(bool reset_checkbox_data) {
-        FS::GetDirList(device, cwd, data.entries);
+        DirList::Start(device, cwd, data.entries);
 
         if (reset_checkbox_data)
             Windows::ResetCheckbox(data);
     }
 
-    static void HandleMultipleCopy(WindowData &data, bool (*func)()) {
-        std::vector<FsDirectoryEntry> entries;
-        if (!FS::GetDirList(data.checkbox_data.device, data.checkbox_data.cwd, entries))
-            return;
+    // The checked entries belong to another folder, on this device or another one.
+    static bool IsCheckedElsewhere(const WindowData &data) {
+        return ((data.checkbox_data.device + data.checkbox_data.cwd) != (device + cwd));
+    }
 
-        std::sort(entries.begin(), entries.end(), FileBrowser::Sort);
-        
-        for (std::size_t i = 0; i < data.checkbox_data.checked_copy.size(); i++) {
-            if (std::strncmp(entries[i].name, "..", 2) == 0)
-                continue;
-            
-            if (data.checkbox_data.checked_copy[i]) {
-                std::string path = data.checkbox_data.device + data.checkbox_data.cwd;
-                FS::Copy(entries[i], path);
+    // The checked names and types are all we need, the source folder isn't listed again.
+    // Copies are queued, their entries get added by the file browser once the transfer thread is done with them.
+    static void HandleMultipleCopy(WindowData &data, bool (*func)(), bool add_entries) {
+        const std::string path = data.checkbox_data.device + data.checkbox_data.cwd;
 
-                if (!(*func)()) {
-                    Options::RefreshEntries(true);
-                    break;
-                }
-            }
+        for (const auto &[name, type] : data.checkbox_data.checked) {
+            DirEntry entry;
+            entry.name = name.c_str();
+            entry.name_length = static_cast<u16>(name.length());
+            entry.type = type;
+            FS::Copy(entry, path);
+
+            if (!(*func)())
+                break;
+            
+            if (add_entries)
+                FileBrowser::AddEntry(data, name, type);
         }
         
-        Options::RefreshEntries(true);
-        sort = -1;
-        entries.clear();
+        Windows::ResetCheckbox(data);
     }
 }
 
 namespace Popups {
     static bool copy = false, move = false;
 
+    // What a single copy/move will add to the destination listing once pasted
+    static std::string copy_filename;
+    static u8 copy_type = FsDirEntryType_File;
+
+    static void SetCopyEntry(const DirEntry &entry) {
+        copy_filename = entry.name;
+        copy_type = entry.type;
+    }
+
     void OptionsPopup(WindowData &data) {
         Popups::SetupPopup(strings[cfg.lang][Lang::OptionsTitle]);
 
         if (ImGui::BeginPopupModal(strings[cfg.lang][Lang::OptionsTitle], nullptr, ImGuiWindowFlags_AlwaysAutoResize)) {
             if (ImGui::Button(strings[cfg.lang][Lang::OptionsSelectAll], ImVec2(200, 50))) {
-                if ((data.checkbox_data.cwd.length() != 0) && (data.checkbox_data.cwd != cwd))
-                    Windows::ResetCheckbox(data);
-                
+                Windows::ResetCheckbox(data);
                 data.checkbox_data.cwd = cwd;
                 data.checkbox_data.device = device;
-                std::fill(data.checkbox_data.checked.begin() + 1, data.checkbox_data.checked.end(), true);
-                data.checkbox_data.count = data.checkbox_data.checked.size();
+                data.checkbox_data.checked.reserve(data.entries.size());
+
+                for (const DirEntry &entry : data.entries) {
+                    if (!(entry.flags & DirEntryFlagParent))
+                        data.checkbox_data.checked.emplace(entry.name, entry.type);
+                }
             }
 
             ImGui::SameLine(0.0f, 15.0f);
@@ -84,10 +98,19 @@ namespace Popups {
 
             if (ImGui::Button(strings[cfg.lang][Lang::OptionsRename], ImVec2(200, 50))) {
                 std::string path = Keyboard::GetText(strings[cfg.lang][Lang::OptionsRenamePrompt], data.entries[data.selected].name);
+                u8 type = data.entries[data.selected].type;
                 
                 if (FS::Rename(data.entries[data.selected], path.c_str())) {
-                    Options::RefreshEntries(false);
-                    sort = -1;
+                    FileBrowser::RemoveEntry(data, data.entries[data.selected]);
+
+                    // Renaming into a sub folder moves the entry out of this one, and that folder has to be listed again
+                    if (path.find('/') == std::string::npos)
+                        FileBrowser::AddEntry(data, path, type);
+                    else {
+                        std::string folder = std::filesystem::path(FS::BuildPath(path, false)).lexically_normal().parent_path();
+                        DirList::Invalidate(device + folder);
+                        Index::Invalidate(device, folder);
+                    }
                 }
                 
                 ImGui::CloseCurrentPopup();
@@ -101,8 +124,8 @@ namespace Popups {
                 std::string path = FS::BuildPath(name, true);
 
                 if (R_SUCCEEDED(mkdir(path.c_str(), 0700))) {
-                    Options::RefreshEntries(true);
-                    sort = -1;
+                    FileBrowser::AddEntry(data, name, FsDirEntryType_Dir);
+                    Windows::ResetCheckbox(data);
                 }
                 
                 ImGui::CloseCurrentPopup();
@@ -119,8 +142,8 @@ namespace Popups {
                 fclose(file);
                 
                 if (FS::FileExists(path)) {
-                    Options::RefreshEntries(true);
-                    sort = -1;
+                    FileBrowser::AddEntry(data, name, FsDirEntryType_File);
+                    Windows::ResetCheckbox(data);
                 }
                 
                 ImGui::CloseCurrentPopup();
@@ -131,34 +154,26 @@ namespace Popups {
             
             if (ImGui::Button(!copy? strings[cfg.lang][Lang::OptionsCopy] : strings[cfg.lang][Lang::OptionsPaste], ImVec2(200, 50))) {
                 if (!copy) {
-                    if ((data.checkbox_data.count >= 1) && (data.checkbox_data.cwd != cwd))
+                    if ((data.checkbox_data.checked.size() >= 1) && (Options::IsCheckedElsewhere(data)))
                         Windows::ResetCheckbox(data);
-                    if (data.checkbox_data.count <= 1) {
+                    if (data.checkbox_data.checked.size() <= 1) {
                         std::string path = device + cwd;
                         FS::Copy(data.entries[data.selected], path);
+                        Popups::SetCopyEntry(data.entries[data.selected]);
                     }
                         
                     copy = !copy;
                     data.state = WINDOW_STATE_FILEBROWSER;
                 }
                 else {
-                    ImGui::EndPopup();
-                    ImGui::PopStyleVar();
-                    ImGui::Render();
-
-                    if ((data.checkbox_data.count > 1) && (data.checkbox_data.cwd != cwd))
-                        Options::HandleMultipleCopy(data, std::addressof(FS::Paste));
-                    else {
-                        if (FS::Paste()) {
-                            Options::RefreshEntries(true);
-                            sort = -1;
-                        }
-                    }
+                    if ((data.checkbox_data.checked.size() > 1) && (Options::IsCheckedElsewhere(data)))
+                        Options::HandleMultipleCopy(data, std::addressof(FS::Paste), false);
+                    else if (FS::Paste())
+                        Windows::ResetCheckbox(data);
 
                     copy = !copy;
-                    //ImGui::CloseCurrentPopup();
+                    ImGui::CloseCurrentPopup();
                     data.state = WINDOW_STATE_FILEBROWSER;
-                    return;
                 }
             }
             
@@ -166,20 +181,21 @@ namespace Popups {
             
             if (ImGui::Button(!move? strings[cfg.lang][Lang::OptionsMove] : strings[cfg.lang][Lang::OptionsPaste], ImVec2(200, 50))) {
                 if (!move) {
-                    if ((data.checkbox_data.count >= 1) && (data.checkbox_data.cwd != cwd))
+                    if ((data.checkbox_data.checked.size() >= 1) && (Options::IsCheckedElsewhere(data)))
                         Windows::ResetCheckbox(data);
-                    if (data.checkbox_data.count <= 1) {
+                    if (data.checkbox_data.checked.size() <= 1) {
                         std::string path = device + cwd;
                         FS::Copy(data.entries[data.selected], path);
+                        Popups::SetCopyEntry(data.entries[data.selected]);
                     }
                 }
                 else {
-                    if ((data.checkbox_data.count > 1) && (data.checkbox_data.cwd != cwd))
-                        Options::HandleMultipleCopy(data, std::addressof(FS::Move));
+                    if ((data.checkbox_data.checked.size() > 1) && (Options::IsCheckedElsewhere(data)))
+                        Options::HandleMultipleCopy(data, std::addressof(FS::Move), true);
                     else {
                         if (FS::Move()) {
-                            Options::RefreshEntries(true);
-                            sort = -1;
+                            FileBrowser::AddEntry(data, copy_filename, copy_type);
+                            Windows::ResetCheckbox(data);
                         }
                     }
                 }
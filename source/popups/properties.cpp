@@ -1,4 +1,5 @@
 #include "config.hpp"
+#include "dirsize.hpp"
 #include "fs.hpp"
 #include "gui.hpp"
 #include "imgui.h"
@@ -23,7 +24,12 @@ namespace Popups {
             
             if (data.entries[data.selected].type == FsDirEntryType_File) {
                 if (!file_stat) {
-                    FS::GetFileSize(data.entries[data.selected].name, size);
+                    // Listings read through fsDirRead already have the size
+                    if (data.entries[data.selected].flags & DirEntryFlagSize)
+                        size = data.entries[data.selected].file_size;
+                    else
+                        FS::GetFileSize(data.entries[data.selected].name, size);
+                    
                     file_stat = true;
                 }
 
@@ -33,6 +39,27 @@ namespace Popups {
                 size_text.append(size_str);
                 ImGui::Text(size_text.c_str());
             }
+            else if (!(data.entries[data.selected].flags & DirEntryFlagParent)) {
+                // Folder sizes are added up in the background and shown as they come in
+                if (!file_stat) {
+                    std::string path = cwd;
+                    path.append((cwd.compare("/") == 0)? "" : "/");
+                    path.append(data.entries[data.selected].name);
+                    DirSize::Start(device, path);
+                    file_stat = true;
+                }
+
+                DirSizeResult result;
+                DirSize::Get(result);
+
+                char size_str[16];
+                Utils::GetSizeString(size_str, static_cast<double>(result.size));
+                std::string size_text = strings[cfg.lang][Lang::PropertiesSize];
+                size_text.append(size_str);
+                size_text.append(result.done? "" : "...");
+                ImGui::Text(size_text.c_str());
+                ImGui::Text(strings[cfg.lang][Lang::PropertiesContains], result.files, result.folders);
+            }
             
             FsTimeStampRaw timestamp;
             if (FS::GetTimeStamp(data.entries[data.selected], timestamp)) {
@@ -56,6 +83,7 @@ namespace Popups {
             ImGui::Dummy(ImVec2(0.0f, 5.0f)); // Spacing
             
             if (ImGui::Button(strings[cfg.lang][Lang::ButtonOK], ImVec2(120, 0))) {
+                DirSize::Cancel();
                 file_stat = false;
                 ImGui::CloseCurrentPopup();
                 data.state = WINDOW_STATE_OPTIONS;
@@ -84,7 +112,11 @@ namespace Popups {
             ImGui::Dummy(ImVec2(0.0f, 5.0f)); // Spacing
             
             if (!file_stat) {
-                FS::GetFileSize(data.entries[data.selected].name, size);
+                if (data.entries[data.selected].flags & DirEntryFlagSize)
+                    size = data.entries[data.selected].file_size;
+                else
+                    FS::GetFileSize(data.entries[data.selected].name, size);
+                
                 file_stat = true;
             }
 
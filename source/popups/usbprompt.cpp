@@ -1,8 +1,12 @@
 #include "config.hpp"
+#include "dirlist.hpp"
+#include "dirsize.hpp"
 #include "fs.hpp"
 #include "imgui.h"
 #include "language.hpp"
 #include "popups.hpp"
+#include "search.hpp"
+#include "transfer.hpp"
 #include "usb.hpp"
 #include "windows.hpp"
 
@@ -22,6 +26,14 @@ namespace Popups {
             
             if (ImGui::Button(strings[cfg.lang][Lang::ButtonOK], ImVec2(120, 0))) {
                 if (!done) {
+                    // Make sure we aren't still listing, adding up or searching a folder on the device we're about to unmount
+                    DirList::Cancel();
+                    DirSize::Cancel();
+                    Search::Cancel();
+
+                    // Copies keep their journal, pasting them again once the drive is back carries on
+                    Transfer::Suspend();
+                    DirList::ClearCache();
                     USB::Unmount();
                     
                     // Reset device back to sdmc
@@ -29,10 +41,9 @@ namespace Popups {
                     fs = std::addressof(devices[FileSystemSDMC]);
                     
                     cwd = "/";
-                    data.entries.clear();
-                    FS::GetDirList(device, cwd, data.entries);
+                    DirList::Start(device, cwd, data.entries);
                     
-                    data.checkbox_data.checked.resize(data.entries.size());
+                    Windows::ResetCheckbox(data);
                     FS::GetUsedStorageSpace(data.used_storage);
                     FS::GetTotalStorageSpace(data.total_storage);
                     sort = -1;
@@ -0,0 +1,304 @@
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+
+#include "fs.hpp"
+#include "index.hpp"
+#include "log.hpp"
+#include "search.hpp"
+#include "windows.hpp"
+
+namespace Search {
+    // Folders are read by a few threads at once, more than that just queues up on the same storage.
+    static constexpr int search_threads_max = 3;
+
+    static Thread threads[search_threads_max];
+    static int threads_created = 0;
+    static std::atomic<bool> cancel = false;
+    static std::atomic<int> threads_running = 0, threads_walking = 0;
+    static std::atomic<u64> folder_count = 0;
+
+    static std::string job_device;
+    static std::vector<std::string> job_tokens;
+
+    // Folders still to be read, shared by all search threads. Folders that are already indexed
+    // are only read again if their mtime changed, new ones are always read.
+    typedef struct {
+        std::string path;
+        bool indexed = false;
+    } SearchFolderJob;
+
+    // folders_busy counts the folders being read, which can still queue more. The walk is over once
+    // nothing is queued and nothing is being read, both are only changed under folders_mutex.
+    static std::mutex folders_mutex;
+    static std::condition_variable folders_cond;
+    static std::vector<SearchFolderJob> folders;
+    static int folders_busy = 0;
+    static bool index_pending = false;
+
+    // Matches listed from the index can turn out to be gone once their folder is read again, their paths
+    // are handed to Poll() to drop them. A removed folder takes every match below it along.
+    static std::mutex pending_mutex;
+    static std::vector<SearchResult> pending;
+    static std::vector<std::string> pending_removed;
+
+    // Waits while the queue is empty but other threads are still reading folders. Returns false once the walk is over or cancelled.
+    static bool GetFolder(SearchFolderJob &job) {
+        std::unique_lock lock(folders_mutex);
+        folders_cond.wait(lock, []() { return ((!folders.empty()) || (folders_busy == 0) || (cancel)); });
+
+        if ((folders.empty()) || (cancel))
+            return false;
+
+        job = std::move(folders.back());
+        folders.pop_back();
+        folders_busy++;
+        return true;
+    }
+
+    // Queues the sub folders a folder turned up, in the same step as it stops counting as busy.
+    static void FinishFolder(std::vector<SearchFolderJob> &sub_folders) {
+        {
+            std::scoped_lock lock(folders_mutex);
+            folders.insert(folders.end(), std::make_move_iterator(sub_folders.begin()), std::make_move_iterator(sub_folders.end()));
+            folders_busy--;
+        }
+
+        folders_cond.notify_all();
+    }
+
+    static void SearchFolder(const SearchFolderJob &job, DirReader &reader, DirListing &listing, std::vector<SearchFolderJob> &sub_folders) {
+        const std::string &path = job.path;
+        const time_t mtime = FS::GetModifiedTime(job_device + path);
+        std::vector<SearchResult> results;
+        std::vector<const DirEntry *> added;
+        std::vector<std::string> removed;
+
+        folder_count++;
+
+        // A zero mtime means the filesystem doesn't report one, so the folder can't be trusted to be unchanged.
+        if ((job.indexed) && (mtime != 0) && (Index::GetFolderTime(path) == mtime))
+            return;
+
+        if (!FS::OpenDir(job_device, path, reader)) {
+            Index::RemoveFolder(path);
+
+            std::scoped_lock lock(pending_mutex);
+            pending_removed.push_back(path);
+            return;
+        }
+
+        listing.clear();
+        while ((!cancel) && (FS::ReadDir(reader, listing, 256) != 0));
+        FS::CloseDir(reader);
+
+        if (cancel)
+            return;
+
+        Index::SetFolder(path, mtime, listing, added, removed);
+
+        // Indexed folders already had their matches listed, only what's new in them gets added.
+        for (const DirEntry *entry : added) {
+            if (entry->type == FsDirEntryType_Dir) {
+                std::string folder_path = path;
+                folder_path.append((path.compare("/") == 0)? "" : "/");
+                folder_path.append(entry->name);
+
+                if (!Index::HasFolder(folder_path))
+                    sub_folders.push_back({ std::move(folder_path), false });
+            }
+
+            if (FileBrowser::MatchEntry(*entry, job_tokens))
+                results.push_back({ path, entry->name, entry->type, entry->file_type });
+        }
+
+        if ((!results.empty()) || (!removed.empty())) {
+            std::scoped_lock lock(pending_mutex);
+            pending.insert(pending.end(), std::make_move_iterator(results.begin()), std::make_move_iterator(results.end()));
+            pending_removed.insert(pending_removed.end(), std::make_move_iterator(removed.begin()), std::make_move_iterator(removed.end()));
+        }
+    }
+
+    // The index is loaded by the first thread to start, reading it from the SD card would hold up the UI for frames on
+    // a big one. The other threads wait for the folders it queues, the load counts as a folder being read until then.
+    static void LoadIndex(void) {
+        std::vector<SearchResult> results;
+        std::vector<std::string> paths;
+        std::vector<SearchFolderJob> jobs;
+
+        // With an index the matches are there right away, the threads only refresh what changed since.
+        if (Index::Begin(job_device))
+            Index::Find(job_tokens, results);
+        
+        if (!results.empty()) {
+            std::scoped_lock lock(pending_mutex);
+            pending.insert(pending.end(), std::make_move_iterator(results.begin()), std::make_move_iterator(results.end()));
+        }
+
+        Index::GetFolders(paths);
+
+        for (std::string &path : paths)
+            jobs.push_back({ std::move(path), true });
+        
+        if (jobs.empty())
+            jobs.push_back({ "/", false });
+        
+        Search::FinishFolder(jobs);
+    }
+
+    static bool IsRemoved(const SearchResult &result, const std::vector<std::string> &removed) {
+        std::string path = result.path;
+        path.append((result.path.compare("/") == 0)? "" : "/");
+        path.append(result.name);
+
+        for (const std::string &removed_path : removed) {
+            if (path.compare(0, removed_path.length(), removed_path) != 0)
+                continue;
+
+            // The match itself, or anything inside a removed folder
+            if ((path.length() == removed_path.length()) || (removed_path.compare("/") == 0) || (path[removed_path.length()] == '/'))
+                return true;
+        }
+
+        return false;
+    }
+
+    static void SearchThreadFunc(void *arg) {
+        (void)arg;
+
+        DirReader reader;
+        DirListing listing;
+        SearchFolderJob job;
+        std::vector<SearchFolderJob> sub_folders;
+        bool load = false;
+
+        {
+            std::scoped_lock lock(folders_mutex);
+            load = index_pending;
+            index_pending = false;
+        }
+
+        if ((load) && (!cancel))
+            Search::LoadIndex();
+
+        // A thread only stops once there's nothing queued and no other thread can queue more.
+        while (Search::GetFolder(job)) {
+            sub_folders.clear();
+            Search::SearchFolder(job, reader, listing, sub_folders);
+            Search::FinishFolder(sub_folders);
+        }
+
+        // The last thread out saves the index, unless the search was cancelled halfway
+        if ((--threads_walking == 0) && (!cancel))
+            Index::End();
+
+        threads_running--;
+    }
+
+    void Start(const std::string &device, const std::string &query) {
+        Search::Cancel();
+
+        job_device = device;
+        job_tokens = FileBrowser::GetMatchTokens(query);
+        folder_count = 0;
+
+        {
+            std::scoped_lock lock(pending_mutex);
+            pending.clear();
+            pending_removed.clear();
+        }
+
+        {
+            std::scoped_lock lock(folders_mutex);
+            folders.clear();
+            folders_busy = 1;
+            index_pending = true;
+        }
+
+        threads_running = search_threads_max;
+        threads_walking = 0;
+
+        for (int i = 0; i < search_threads_max; i++) {
+            Result ret = 0;
+
+            if (R_FAILED(ret = threadCreate(std::addressof(threads[threads_created]), SearchThreadFunc, nullptr, nullptr, 0x10000, 0x2C, -2))) {
+                Log::Error("Search::Start threadCreate() failed: 0x%x\n", ret);
+                threads_running--;
+                continue;
+            }
+
+            threads_walking++;
+            if (R_FAILED(ret = threadStart(std::addressof(threads[threads_created])))) {
+                Log::Error("Search::Start threadStart() failed: 0x%x\n", ret);
+                threadClose(std::addressof(threads[threads_created]));
+                threads_running--;
+                threads_walking--;
+                continue;
+            }
+
+            threads_created++;
+        }
+
+        // Without any thread the search runs here, the results show up once it's done.
+        if (threads_created == 0) {
+            threads_running = 1;
+            threads_walking = 1;
+            Search::SearchThreadFunc(nullptr);
+        }
+    }
+
+    bool Poll(std::vector<SearchResult> &results) {
+        std::vector<SearchResult> new_results;
+        std::vector<std::string> removed;
+
+        {
+            std::scoped_lock lock(pending_mutex);
+            new_results.swap(pending);
+            removed.swap(pending_removed);
+        }
+
+        if ((threads_running == 0) && (threads_created != 0))
+            Search::Cancel();
+
+        if ((new_results.empty()) && (removed.empty()))
+            return false;
+
+        results.insert(results.end(), std::make_move_iterator(new_results.begin()), std::make_move_iterator(new_results.end()));
+
+        // New matches can come from a folder that another thread has since found gone, so they're checked as well
+        if (!removed.empty()) {
+            results.erase(std::remove_if(results.begin(), results.end(), [&removed](const SearchResult &result) {
+                return Search::IsRemoved(result, removed);
+            }), results.end());
+        }
+
+        return true;
+    }
+
+    bool Busy(void) {
+        return (threads_running != 0);
+    }
+
+    u64 GetFolderCount(void) {
+        return folder_count;
+    }
+
+    void Cancel(void) {
+        {
+            std::scoped_lock lock(folders_mutex);
+            cancel = true;
+        }
+
+        folders_cond.notify_all();
+
+        for (int i = 0; i < threads_created; i++) {
+            threadWaitForExit(std::addressof(threads[i]));
+            threadClose(std::addressof(threads[i]));
+        }
+
+        threads_created = 0;
+        threads_running = 0;
+        cancel = false;
+    }
+}
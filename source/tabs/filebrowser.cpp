@@ -1,12 +1,19 @@
 #include <algorithm>
 #include <cstring>
+#include <ctime>
 
 #include "config.hpp"
+#include "dirlist.hpp"
+#include "dirsize.hpp"
 #include "fs.hpp"
 #include "imgui.h"
 #include "imgui_internal.h"
+#include "index.hpp"
+#include "keyboard.hpp"
+#include "language.hpp"
 #include "tabs.hpp"
 #include "textures.hpp"
+#include "transfer.hpp"
 #include "utils.hpp"
 
 int sort = 0;
@@ -14,75 +21,577 @@ std::vector<std::string> devices_list = { "sdmc:", "safe:", "user:", "system:" }
 std::recursive_mutex devices_list_mutex;
 
 namespace FileBrowser {
-    // Sort without using ImGuiTableSortSpecs
-    bool Sort(const FsDirectoryEntry &entryA, const FsDirectoryEntry &entryB) {
-        // Make sure ".." stays at the top regardless of sort direction
-        if (strcasecmp(entryA.name, "..") == 0)
-            return true;
+    // What std::sort moves around instead of the entries themselves. The first 8 bytes of the
+    // collation key (or the size/date) decide most comparisons without touching the names.
+    typedef struct {
+        u64 primary = 0;
+        u64 secondary = 0;
+        u32 index = 0;
+        u8 group = 0;
+    } SortKey;
+
+    static bool IsDigit(char c) {
+        return ((c >= '0') && (c <= '9'));
+    }
+
+    // Compares runs of digits by their value, so "file2" comes before "file10".
+    static int CompareNatural(const char *a, const char *b) {
+        while ((*a != '\0') && (*b != '\0')) {
+            if ((IsDigit(*a)) && (IsDigit(*b))) {
+                const char *a_start = a, *b_start = b;
+                
+                while (*a == '0')
+                    a++;
+                while (*b == '0')
+                    b++;
+                
+                const char *a_digits = a, *b_digits = b;
+
+                while (IsDigit(*a))
+                    a++;
+                while (IsDigit(*b))
+                    b++;
+                
+                // Longer run without leading zeros is the bigger number, otherwise compare digit by digit
+                if ((a - a_digits) != (b - b_digits))
+                    return ((a - a_digits) < (b - b_digits))? -1 : 1;
+                
+                int ret = std::memcmp(a_digits, b_digits, a - a_digits);
+                if (ret != 0)
+                    return ret;
+                
+                // Same value, "01" goes after "1"
+                if ((a - a_start) != (b - b_start))
+                    return ((a - a_start) < (b - b_start))? -1 : 1;
+                
+                continue;
+            }
+
+            if (*a != *b)
+                return (static_cast<u8>(*a) < static_cast<u8>(*b))? -1 : 1;
+            
+            a++;
+            b++;
+        }
+
+        return static_cast<int>(static_cast<u8>(*a)) - static_cast<int>(static_cast<u8>(*b));
+    }
+
+    // Has to order keys the same way as the full comparison. With natural sorting a digit run
+    // is packed as '0', which compares against any other character like every digit does.
+    static u64 GetKeyPrefix(const char *key, bool natural) {
+        u64 prefix = 0;
+
+        for (int i = 0; (i < 8) && (key[i] != '\0'); i++) {
+            if ((natural) && (IsDigit(key[i]))) {
+                prefix |= static_cast<u64>('0') << (56 - (i * 8));
+                break;
+            }
+
+            prefix |= static_cast<u64>(static_cast<u8>(key[i])) << (56 - (i * 8));
+        }
+
+        return prefix;
+    }
+
+    // Maps a signed value to an unsigned one that keeps the same order.
+    static u64 GetValueKey(s64 value) {
+        return static_cast<u64>(value) ^ (1ULL << 63);
+    }
+
+    // Entries of the same size/date are kept in filename order, equal names in listing order.
+    // This makes the order total, so splitting the sort across threads gives the exact same result.
+    typedef struct {
+        const DirListing *entries;
+        bool natural;
+        bool by_name;
+        bool descending;
+
+        bool operator()(const SortKey &keyA, const SortKey &keyB) const {
+            if (keyA.group != keyB.group)
+                return (keyA.group < keyB.group);
+            
+            if (keyA.primary != keyB.primary)
+                return (keyA.primary < keyB.primary);
+            
+            if (keyA.secondary != keyB.secondary)
+                return (keyA.secondary < keyB.secondary);
+            
+            const DirEntry &entryA = (*entries)[keyA.index];
+            const DirEntry &entryB = (*entries)[keyB.index];
+            const char *nameA = DirListing::GetKey(entryA), *nameB = DirListing::GetKey(entryB);
+            int ret = natural? FileBrowser::CompareNatural(nameA, nameB) : std::strcmp(nameA, nameB);
+            
+            if ((by_name) && (descending))
+                ret = -ret;
+            
+            if (ret != 0)
+                return (ret < 0);
+            
+            return (entryA.id < entryB.id);
+        }
+    } SortCompare;
+
+    // Below this many keys per core it isn't worth starting threads.
+    static constexpr std::size_t parallel_sort_min = 0x2000;
+
+    typedef struct {
+        std::vector<SortKey>::iterator begin, middle, end;
+        const SortCompare *compare;
+    } SortJob;
+
+    static void SortThreadFunc(void *arg) {
+        SortJob *job = static_cast<SortJob *>(arg);
+
+        if (job->middle == job->begin)
+            std::sort(job->begin, job->end, *job->compare);
+        else
+            std::inplace_merge(job->begin, job->middle, job->end, *job->compare);
+    }
+
+    // Cores the application is allowed to run on, starting with the one the UI thread is on.
+    static const std::vector<int> &GetCores(void) {
+        static std::vector<int> cores;
+
+        if (cores.empty()) {
+            u64 core_mask = 0;
+            int current_core = static_cast<int>(svcGetCurrentProcessorNumber());
+            cores.push_back(current_core);
+
+            if (R_SUCCEEDED(svcGetInfo(std::addressof(core_mask), InfoType_CoreMask, CUR_PROCESS_HANDLE, 0))) {
+                for (int i = 0; i < 64; i++) {
+                    if ((core_mask & BIT(i)) && (i != current_core))
+                        cores.push_back(i);
+                }
+            }
+        }
+
+        return cores;
+    }
+
+    // Runs the first job on this thread and the rest on the other cores, or here if a thread can't be created.
+    static void RunSortJobs(std::vector<SortJob> &jobs) {
+        const std::vector<int> &cores = FileBrowser::GetCores();
+        std::vector<Thread> threads(jobs.size());
+        std::vector<bool> started(jobs.size(), false);
+
+        for (std::size_t i = 1; i < jobs.size(); i++) {
+            if (R_FAILED(threadCreate(std::addressof(threads[i]), SortThreadFunc, std::addressof(jobs[i]), nullptr, 0x10000, 0x2C, cores[i % cores.size()])))
+                continue;
+            
+            if (R_FAILED(threadStart(std::addressof(threads[i])))) {
+                threadClose(std::addressof(threads[i]));
+                continue;
+            }
+
+            started[i] = true;
+        }
+
+        for (std::size_t i = 0; i < jobs.size(); i++) {
+            if (!started[i])
+                FileBrowser::SortThreadFunc(std::addressof(jobs[i]));
+        }
+
+        for (std::size_t i = 1; i < jobs.size(); i++) {
+            if (started[i]) {
+                threadWaitForExit(std::addressof(threads[i]));
+                threadClose(std::addressof(threads[i]));
+            }
+        }
+    }
+
+    // Sorts one chunk per core, then merges neighbouring chunks pairwise until one is left.
+    static void ParallelSort(std::vector<SortKey>::iterator begin, std::vector<SortKey>::iterator end, const SortCompare &compare) {
+        std::size_t count = static_cast<std::size_t>(end - begin);
+        std::size_t chunks = std::min(FileBrowser::GetCores().size(), count / parallel_sort_min);
+
+        if (chunks < 2) {
+            std::sort(begin, end, compare);
+            return;
+        }
+
+        std::vector<std::vector<SortKey>::iterator> bounds;
+        for (std::size_t i = 0; i <= chunks; i++)
+            bounds.push_back(begin + ((count * i) / chunks));
         
-        if (strcasecmp(entryB.name, "..") == 0)
-            return false;
+        std::vector<SortJob> jobs;
+        for (std::size_t i = 0; i < chunks; i++)
+            jobs.push_back({ bounds[i], bounds[i], bounds[i + 1], std::addressof(compare) });
         
-        if ((entryA.type == FsDirEntryType_Dir) && !(entryB.type == FsDirEntryType_Dir))
-            return true;
-        else if (!(entryA.type == FsDirEntryType_Dir) && (entryB.type == FsDirEntryType_Dir))
-            return false;
+        FileBrowser::RunSortJobs(jobs);
 
-        switch(sort) {
-            case FS_SORT_ALPHA_ASC:
-                return (strcasecmp(entryA.name, entryB.name) < 0);
-                break;
+        while (bounds.size() > 2) {
+            std::vector<std::vector<SortKey>::iterator> merged_bounds;
+            jobs.clear();
 
-            case FS_SORT_ALPHA_DESC:
-                return (strcasecmp(entryB.name, entryA.name) < 0);
-                break;
+            for (std::size_t i = 0; i + 2 < bounds.size(); i += 2) {
+                jobs.push_back({ bounds[i], bounds[i + 1], bounds[i + 2], std::addressof(compare) });
+                merged_bounds.push_back(bounds[i]);
+            }
+
+            // An odd chunk out is carried over to the next round as is
+            if ((bounds.size() % 2) == 0)
+                merged_bounds.push_back(bounds[bounds.size() - 2]);
+            
+            merged_bounds.push_back(bounds.back());
+            FileBrowser::RunSortJobs(jobs);
+            bounds.swap(merged_bounds);
+        }
+    }
+
+    static SortCompare GetSortCompare(const DirListing &entries, int sort_mode) {
+        const bool by_name = ((sort_mode == FS_SORT_ALPHA_ASC) || (sort_mode == FS_SORT_ALPHA_DESC));
+        const bool descending = ((sort_mode == FS_SORT_ALPHA_DESC) || (sort_mode == FS_SORT_SIZE_DESC) || (sort_mode == FS_SORT_DATE_DESC));
+        return { std::addressof(entries), cfg.natural_sort, by_name, descending };
+    }
+
+    static SortKey GetSortKey(const DirEntry &entry, std::size_t index, int sort_mode, const SortCompare &compare) {
+        SortKey key;
+        
+        // ".." stays at the top regardless of sort direction, followed by folders
+        key.index = static_cast<u32>(index);
+        key.group = (entry.flags & DirEntryFlagParent)? 0 : ((entry.type == FsDirEntryType_Dir)? 1 : 2);
+        
+        if (compare.by_name)
+            key.primary = FileBrowser::GetKeyPrefix(DirListing::GetKey(entry), compare.natural);
+        else {
+            key.primary = FileBrowser::GetValueKey(((sort_mode == FS_SORT_SIZE_ASC) || (sort_mode == FS_SORT_SIZE_DESC))? entry.file_size : static_cast<s64>(entry.modified));
+            key.secondary = FileBrowser::GetKeyPrefix(DirListing::GetKey(entry), compare.natural);
+        }
+        
+        if (compare.descending)
+            key.primary = ~key.primary;
+        
+        return key;
+    }
+
+    void SortEntries(DirListing &entries, int sort_mode, std::size_t offset) {
+        if (sort_mode < 0)
+            sort_mode = FS_SORT_ALPHA_ASC;
+        
+        const SortCompare compare = FileBrowser::GetSortCompare(entries, sort_mode);
+        std::vector<SortKey> keys;
+        keys.reserve(entries.size());
+
+        for (std::size_t i = 0; i < entries.size(); i++)
+            keys.push_back(FileBrowser::GetSortKey(entries[i], i, sort_mode, compare));
+
+        // Entries before offset are already sorted, only sort the rest and merge them in.
+        if (offset > keys.size())
+            offset = 0;
+        
+        FileBrowser::ParallelSort(keys.begin() + offset, keys.end(), compare);
+        if (offset != 0)
+            std::inplace_merge(keys.begin(), keys.begin() + offset, keys.end(), compare);
+        
+        std::vector<u32> order;
+        order.reserve(keys.size());
+        
+        for (const SortKey &key : keys)
+            order.push_back(key.index);
+        
+        entries.Permute(order);
+    }
+
+    // Moves the last entry of an already sorted listing to its place with a binary search.
+    static std::size_t InsertEntry(DirListing &entries, int sort_mode) {
+        if (sort_mode < 0)
+            sort_mode = FS_SORT_ALPHA_ASC;
+        
+        const SortCompare compare = FileBrowser::GetSortCompare(entries, sort_mode);
+        std::size_t last = entries.size() - 1, low = 0, high = last;
+        const SortKey key = FileBrowser::GetSortKey(entries[last], last, sort_mode, compare);
+
+        while (low < high) {
+            std::size_t middle = low + ((high - low) / 2);
+
+            if (compare(key, FileBrowser::GetSortKey(entries[middle], middle, sort_mode, compare)))
+                high = middle;
+            else
+                low = middle + 1;
         }
 
-        return false;
+        std::rotate(entries.begin() + low, entries.begin() + last, entries.end());
+        return low;
     }
 
-    // Sort using ImGuiTableSortSpecs
-    bool TableSort(const FsDirectoryEntry &entryA, const FsDirectoryEntry &entryB) {
-        bool descending = false;
-        ImGuiTableSortSpecs *table_sort_specs = ImGui::TableGetSortSpecs();
+    static void EraseEntry(WindowData &data, std::size_t index) {
+        DirSize::Invalidate(FS::BuildPath(data.entries[index]));
+        DirList::EntryRemoved(data.entries[index]);
+        Index::EntryRemoved(device, cwd, data.entries[index]);
+
+        if (Windows::IsChecked(data, data.entries[index]))
+            data.checkbox_data.checked.erase(data.entries[index].name);
+
+        data.entries.Remove(index);
         
-        for (int i = 0; i < table_sort_specs->SpecsCount; ++i) {
-            const ImGuiTableColumnSortSpecs *column_sort_spec = std::addressof(table_sort_specs->Specs[i]);
-            descending = (column_sort_spec->SortDirection == ImGuiSortDirection_Descending);
+        if ((data.selected >= data.entries.size()) && (data.selected != 0))
+            data.selected = data.entries.size() - 1;
+    }
 
-            // Make sure ".." stays at the top regardless of sort direction
-            if (strcasecmp(entryA.name, "..") == 0)
-                return true;
+    // File operations in the current folder update the listing in place, it's only listed again if it isn't complete yet.
+    void AddEntry(WindowData &data, const std::string &name, u8 type) {
+        if (!DirList::Modify(data.entries)) {
+            Index::Invalidate(device, cwd);
+            DirList::Start(device, cwd, data.entries);
+            return;
+        }
+
+        // Pasting over an existing file replaces its entry
+        for (std::size_t i = 0; i < data.entries.size(); i++) {
+            if ((!(data.entries[i].flags & DirEntryFlagParent)) && (name.compare(data.entries[i].name) == 0)) {
+                FileBrowser::EraseEntry(data, i);
+                break;
+            }
+        }
+
+        DirEntry &entry = data.entries.Add(name.c_str(), type, 0);
+        DirSize::Invalidate(FS::BuildPath(entry));
+        FS::GetMetadata(device, cwd, entry);
+        DirList::EntryAdded(entry);
+        Index::EntryAdded(device, cwd, entry);
+
+        FileBrowser::InsertEntry(data.entries, sort);
+    }
+
+    // Finds token in [string, end) and returns the end of the match, memchr() does the scanning with SIMD.
+    static const char *FindToken(const char *string, const char *end, const std::string &token) {
+        const std::size_t length = token.length();
+
+        while (static_cast<std::size_t>(end - string) >= length) {
+            const char *match = static_cast<const char *>(std::memchr(string, token[0], (end - string) - length + 1));
+            if (!match)
+                return nullptr;
             
-            if (strcasecmp(entryB.name, "..") == 0)
-                return false;
+            if (std::memcmp(match + 1, token.data() + 1, length - 1) == 0)
+                return match + length;
             
-            if ((entryA.type == FsDirEntryType_Dir) && !(entryB.type == FsDirEntryType_Dir))
-                return true;
-            else if (!(entryA.type == FsDirEntryType_Dir) && (entryB.type == FsDirEntryType_Dir))
+            string = match + 1;
+        }
+
+        return nullptr;
+    }
+
+    // Splits a query into case-folded words, matched against the keys the listing already has.
+    std::vector<std::string> GetMatchTokens(const std::string &query) {
+        std::vector<std::string> tokens;
+        std::string token;
+
+        for (char c : query) {
+            if (c == ' ') {
+                if (!token.empty())
+                    tokens.push_back(std::move(token));
+                
+                token.clear();
+                continue;
+            }
+
+            token.push_back(((c >= 'A') && (c <= 'Z'))? (c + ('a' - 'A')) : c);
+        }
+
+        if (!token.empty())
+            tokens.push_back(std::move(token));
+        
+        return tokens;
+    }
+
+    // Every space separated word of the query has to appear in the name, in that order.
+    bool MatchEntry(const DirEntry &entry, const std::vector<std::string> &tokens) {
+        if (entry.flags & DirEntryFlagParent)
+            return true;
+        
+        const char *key = DirListing::GetKey(entry), *end = key + entry.name_length;
+
+        for (const std::string &token : tokens) {
+            if (!(key = FileBrowser::FindToken(key, end, token)))
                 return false;
-            else {
-                switch (column_sort_spec->ColumnIndex) {
-                    case 1: // filename
-                        sort = descending? FS_SORT_ALPHA_DESC : FS_SORT_ALPHA_ASC;
-                        return descending? (strcasecmp(entryB.name, entryA.name) < 0) : (strcasecmp(entryA.name, entryB.name) < 0);
-                        break;
-                        
-                    default:
-                        break;
+        }
+
+        return true;
+    }
+
+    void RemoveEntry(WindowData &data, const DirEntry &entry) {
+        FileBrowser::RemoveEntries(data, { entry });
+    }
+
+    // The listing is only started again once if it wasn't complete, rather than for every entry.
+    void RemoveEntries(WindowData &data, const std::vector<DirEntry> &entries) {
+        if (!DirList::Modify(data.entries)) {
+            Index::Invalidate(device, cwd);
+            DirList::Start(device, cwd, data.entries);
+            return;
+        }
+
+        // Entries are identified by id, as indices shift while removing
+        for (const DirEntry &entry : entries) {
+            for (std::size_t i = 0; i < data.entries.size(); i++) {
+                if (data.entries[i].id == entry.id) {
+                    FileBrowser::EraseEntry(data, i);
+                    break;
                 }
             }
         }
-        
-        return false;
     }
 }
 
 namespace Tabs {
     static const ImVec2 tex_size = ImVec2(21, 21);
 
+    // While sorted by size or date, re-sort as metadata comes in at most every 500ms.
+    static const u64 metadata_sort_interval = 500000000;
+    static u64 metadata_sort_tick = 0;
+    static bool metadata_sort_pending = false;
+
+    // How often the shown folder is checked for changes in the background.
+    static const u64 revalidate_interval = 10000000000;
+    static u64 revalidate_tick = 0;
+
+    // Rows shown while a filter is set. They're rebuilt when the listing changes and only
+    // narrowed down when the query grows, as a longer query can only match fewer names.
+    static std::string filter, filter_query, filter_path;
+    static std::vector<u32> filter_rows;
+    static u64 filter_revision = 0;
+
+    // Set when another tab opened a folder, so the file browser tab gets brought to the front.
+    static bool select_tab = false;
+
+    static void ApplyFilter(const DirListing &entries) {
+        std::string path = device + cwd;
+        if (path != filter_path) {
+            filter.clear();
+            filter_path = path;
+        }
+
+        if (filter.empty()) {
+            filter_query.clear();
+            filter_rows.clear();
+            return;
+        }
+
+        const bool unchanged = (entries.GetRevision() == filter_revision);
+        if ((unchanged) && (filter == filter_query))
+            return;
+        
+        const std::vector<std::string> tokens = FileBrowser::GetMatchTokens(filter);
+        std::vector<u32> rows;
+
+        if ((unchanged) && (!filter_query.empty()) && (filter.compare(0, filter_query.length(), filter_query) == 0)) {
+            for (u32 index : filter_rows) {
+                if (FileBrowser::MatchEntry(entries[index], tokens))
+                    rows.push_back(index);
+            }
+        }
+        else {
+            for (std::size_t i = 0; i < entries.size(); i++) {
+                if (FileBrowser::MatchEntry(entries[i], tokens))
+                    rows.push_back(static_cast<u32>(i));
+            }
+        }
+
+        filter_rows.swap(rows);
+        filter_query = filter;
+        filter_revision = entries.GetRevision();
+    }
+
+    // Reads the sort specs once per sort rather than in every comparison.
+    static int GetTableSortMode(const ImGuiTableSortSpecs *sorts_specs) {
+        for (int i = 0; i < sorts_specs->SpecsCount; ++i) {
+            const ImGuiTableColumnSortSpecs *column_sort_spec = std::addressof(sorts_specs->Specs[i]);
+            bool descending = (column_sort_spec->SortDirection == ImGuiSortDirection_Descending);
+
+            switch (column_sort_spec->ColumnIndex) {
+                case 1: // filename
+                    return descending? FS_SORT_ALPHA_DESC : FS_SORT_ALPHA_ASC;
+
+                case 2: // size
+                    return descending? FS_SORT_SIZE_DESC : FS_SORT_SIZE_ASC;
+
+                case 3: // modified
+                    return descending? FS_SORT_DATE_DESC : FS_SORT_DATE_ASC;
+                
+                default:
+                    break;
+            }
+        }
+
+        return FS_SORT_ALPHA_ASC;
+    }
+
+    // Copies run on the transfer thread, finished ones are added to the listing if it's the folder they went to.
+    // That waits while a popup is open, adding an entry moves the rows it acts on.
+    static void TransferStatus(WindowData &data) {
+        std::vector<TransferJob> jobs;
+
+        if ((data.state == WINDOW_STATE_FILEBROWSER) && (Transfer::Poll(jobs))) {
+            for (const TransferJob &job : jobs) {
+                PathBuilder dest_path(job.dest_device + job.dest_folder);
+                dest_path.Push(job.name);
+                DirSize::Invalidate(std::string(dest_path.view()));
+
+                if ((job.dest_device == device) && (job.dest_folder == cwd)) {
+                    // A folder copy that was cancelled or failed halfway still leaves a folder behind
+                    if ((job.success) || (FS::DirExists(FS::BuildPath(job.name, true))))
+                        FileBrowser::AddEntry(data, job.name, job.type);
+                }
+                else {
+                    DirList::Invalidate(job.dest_device + job.dest_folder);
+                    Index::Invalidate(job.dest_device, job.dest_folder);
+                }
+            }
+        }
+
+        if (!Transfer::Busy())
+            return;
+        
+        TransferProgress progress;
+        Transfer::GetProgress(progress);
+
+        ImGui::Text("%s %s", strings[cfg.lang][Lang::OptionsCopying], progress.name.c_str());
+        ImGui::ProgressBar((progress.job_size != 0)? std::min(static_cast<float>(progress.job_offset) / static_cast<float>(progress.job_size), 1.0f) : 0.0f, ImVec2(1100.0f, 0.0f));
+        ImGui::SameLine();
+
+        if (ImGui::Button(strings[cfg.lang][Lang::ButtonCancel]))
+            Transfer::Cancel();
+        
+        if (progress.bytes_rate > 0.0) {
+            char rate_str[16];
+            Utils::GetSizeString(rate_str, progress.bytes_rate);
+            ImGui::Text(strings[cfg.lang][Lang::TransferStatus], rate_str, progress.files_rate, progress.eta / 3600, (progress.eta / 60) % 60, progress.eta % 60);
+        }
+    }
+
+    // Switches the file browser to a folder from another tab, e.g. a search result.
+    void OpenFolder(WindowData &data, const std::string &folder_device, const std::string &path) {
+        std::size_t index = 0;
+
+        {
+            std::scoped_lock lock(devices_list_mutex);
+
+            auto device_entry = std::find(devices_list.begin(), devices_list.end(), folder_device);
+            if (device_entry == devices_list.end())
+                return;
+            
+            index = static_cast<std::size_t>(device_entry - devices_list.begin());
+        }
+
+        if (!DirList::Start(folder_device, path, data.entries))
+            return;
+        
+        if (folder_device != device) {
+            device = folder_device;
+            fs = std::addressof(devices[index]);
+            FS::GetUsedStorageSpace(data.used_storage);
+            FS::GetTotalStorageSpace(data.total_storage);
+        }
+
+        cwd = path;
+        data.selected = 0;
+        select_tab = true;
+    }
+
     void FileBrowser(WindowData &data) {
-        if (ImGui::BeginTabItem("File Browser")) {
+        if (ImGui::BeginTabItem("File Browser", nullptr, select_tab? ImGuiTabItemFlags_SetSelected : ImGuiTabItemFlags_None)) {
+            select_tab = false;
             ImGui::Dummy(ImVec2(0.0f, 1.0f)); // Spacing
 
             ImGui::PushID("device_list");
@@ -98,10 +607,8 @@ namespace Tabs {
                         fs = std::addressof(devices[i]);
                         
                         cwd = "/";
-                        data.entries.clear();
-                        FS::GetDirList(device, cwd, data.entries);
+                        DirList::Start(device, cwd, data.entries);
                         
-                        data.checkbox_data.checked.resize(data.entries.size());
                         FS::GetUsedStorageSpace(data.used_storage);
                         FS::GetTotalStorageSpace(data.total_storage);
                         sort = -1;
@@ -126,92 +633,160 @@ namespace Tabs {
             ImGui::ProgressBar(static_cast<float>(data.used_storage) / static_cast<float>(data.total_storage), ImVec2(1265.0f, 6.0f), "");
             ImGui::Dummy(ImVec2(0.0f, 1.0f)); // Spacing
 
+            if (ImGui::Button(strings[cfg.lang][Lang::FilterButton])) {
+                std::string text = Keyboard::GetText(strings[cfg.lang][Lang::FilterPrompt], filter);
+                if (!text.empty())
+                    filter = text;
+            }
+
+            if (!filter.empty()) {
+                ImGui::SameLine();
+
+                if (ImGui::Button(strings[cfg.lang][Lang::FilterClear]))
+                    filter.clear();
+                
+                ImGui::SameLine();
+                ImGui::TextUnformatted(filter.c_str());
+            }
+
+            Tabs::TransferStatus(data);
+            
+            ImGui::Dummy(ImVec2(0.0f, 1.0f)); // Spacing
+
             ImGuiTableFlags tableFlags = ImGuiTableFlags_Resizable | ImGuiTableFlags_Sortable | ImGuiTableFlags_BordersInner |
                 ImGuiTableFlags_BordersOuter | ImGuiTableFlags_SizingStretchProp | ImGuiTableFlags_ScrollY;
             
-            if (ImGui::BeginTable("Directory List", 2, tableFlags)) {
+            if (ImGui::BeginTable("Directory List", 4, tableFlags)) {
                 // Make header always visible
                 // ImGui::TableSetupScrollFreeze(0, 1);
 
                 ImGui::TableSetupColumn("", ImGuiTableColumnFlags_NoSort | ImGuiTableColumnFlags_NoHeaderLabel | ImGuiTableColumnFlags_WidthFixed);
                 ImGui::TableSetupColumn("Filename", ImGuiTableColumnFlags_DefaultSort);
+                ImGui::TableSetupColumn("Size", ImGuiTableColumnFlags_WidthFixed | ImGuiTableColumnFlags_PreferSortDescending, 120.0f);
+                ImGui::TableSetupColumn("Modified", ImGuiTableColumnFlags_WidthFixed | ImGuiTableColumnFlags_PreferSortDescending, 200.0f);
                 ImGui::TableHeadersRow();
 
-                if (ImGuiTableSortSpecs *sorts_specs = ImGui::TableGetSortSpecs()) {
+                // Popups act on data.selected, so rows stay where they are until we're back in the browser.
+                // Batches, metadata and re-sorts wait in DirList in the meantime.
+                const bool browsing = (data.state == WINDOW_STATE_FILEBROWSER);
+
+                // Pick up any entries the background enumerator has listed since the last frame
+                std::size_t offset = 0;
+                bool entries_added = (browsing) && (DirList::Poll(data.entries, offset));
+                
+                // File operations update the listing in place, changes made behind our back are picked up here
+                if ((browsing) && (!DirList::Busy()) && (armTicksToNs(armGetSystemTick() - revalidate_tick) >= revalidate_interval)) {
+                    DirList::Revalidate(data.entries);
+                    revalidate_tick = armGetSystemTick();
+                }
+                
+                if ((browsing) && (DirList::UpdateMetadata(data.entries)) && (sort >= FS_SORT_SIZE_ASC))
+                    metadata_sort_pending = true;
+
+                ImGuiTableSortSpecs *sorts_specs = ImGui::TableGetSortSpecs();
+                if ((browsing) && (sorts_specs)) {
                     if (sort == -1)
                         sorts_specs->SpecsDirty = true;
                     
+                    if ((metadata_sort_pending) && ((!DirList::Busy()) || (armTicksToNs(armGetSystemTick() - metadata_sort_tick) >= metadata_sort_interval))) {
+                        metadata_sort_pending = false;
+                        metadata_sort_tick = armGetSystemTick();
+                        sorts_specs->SpecsDirty = true;
+                    }
+                    
                     if (sorts_specs->SpecsDirty) {
-                        std::sort(data.entries.begin(), data.entries.end(), FileBrowser::TableSort);
+                        sort = Tabs::GetTableSortMode(sorts_specs);
+                        FileBrowser::SortEntries(data.entries, sort, 0);
                         sorts_specs->SpecsDirty = false;
                     }
+                    else if (entries_added) {
+                        // Only sort the new batch and merge it into the already sorted entries
+                        FileBrowser::SortEntries(data.entries, sort, offset);
+                    }
                 }
 
-                for (u64 i = 0; i < data.entries.size(); i++) {
-                    ImGui::TableNextRow();
+                Tabs::ApplyFilter(data.entries);
+                const bool filtered = !filter.empty();
+
+                // Only rows that are visible get submitted, so a huge folder costs the same per frame as a small one
+                ImGuiListClipper clipper;
+                clipper.Begin(static_cast<int>(filtered? filter_rows.size() : data.entries.size()));
+
+                while (clipper.Step()) {
+                    for (int row = clipper.DisplayStart; row < clipper.DisplayEnd; row++) {
+                        u64 i = filtered? filter_rows[row] : static_cast<u64>(row);
+
+                        // Entries change under us when a folder is opened from one of the rows
+                        if (i >= data.entries.size())
+                            break;
+                        
+                        ImGui::TableNextRow();
 
-                    ImGui::TableNextColumn();
-                    ImGui::PushID(i);
+                        ImGui::TableNextColumn();
+                        ImGui::PushID(i);
                     
-                    if ((data.checkbox_data.checked[i]) && (data.checkbox_data.cwd.compare(cwd) == 0) && (data.checkbox_data.device.compare(device) == 0))
-                        ImGui::Image(reinterpret_cast<ImTextureID>(check_icon.id), tex_size);
-                    else
-                        ImGui::Image(reinterpret_cast<ImTextureID>(uncheck_icon.id), tex_size);
+                        if (Windows::IsChecked(data, data.entries[i]))
+                            ImGui::Image(reinterpret_cast<ImTextureID>(check_icon.id), tex_size);
+                        else
+                            ImGui::Image(reinterpret_cast<ImTextureID>(uncheck_icon.id), tex_size);
                     
-                    ImGui::PopID();
+                        ImGui::PopID();
 
-                    ImGui::TableNextColumn();
-                    FileType file_type = FS::GetFileType(data.entries[i].name);
+                        ImGui::TableNextColumn();
+                        if (data.entries[i].type == FsDirEntryType_Dir)
+                            ImGui::Image(reinterpret_cast<ImTextureID>(folder_icon.id), tex_size);
+                        else
+                            ImGui::Image(reinterpret_cast<ImTextureID>(file_icons[data.entries[i].file_type].id), tex_size);
                     
-                    if (data.entries[i].type == FsDirEntryType_Dir)
-                        ImGui::Image(reinterpret_cast<ImTextureID>(folder_icon.id), tex_size);
-                    else
-                        ImGui::Image(reinterpret_cast<ImTextureID>(file_icons[file_type].id), tex_size);
-                    
-                    ImGui::SameLine();
-
-                    if (ImGui::Selectable(data.entries[i].name, false)) {
-                        if (data.entries[i].type == FsDirEntryType_Dir) {
-                            if (std::strncmp(data.entries[i].name, "..", 2) == 0) {
-                                if (FS::ChangeDirPrev(data.entries)) {
-                                    if ((data.checkbox_data.count > 1) && (data.checkbox_data.checked_copy.empty()))
-                                        data.checkbox_data.checked_copy = data.checkbox_data.checked;
-                                        
-                                    data.checkbox_data.checked.resize(data.entries.size());
-                                }
+                        ImGui::SameLine();
+
+                        if (ImGui::Selectable(data.entries[i].name, false)) {
+                            if (data.entries[i].type == FsDirEntryType_Dir) {
+                                // The checked entries stay with their own folder, there's nothing to carry over
+                                if (data.entries[i].flags & DirEntryFlagParent)
+                                    FS::ChangeDirPrev(data.entries);
+                                else
+                                    FS::ChangeDirNext(data.entries[i].name, data.entries);
+
+                                // Reset navigation ID and scroll back to the top, ".." may not have been submitted this frame
+                                ImGuiContext& g = *GImGui;
+                                ImGui::SetNavID(ImGui::GetID(data.entries[0].name, 0), g.NavLayer, 0, ImRect());
+                                ImGui::SetScrollY(0.0f);
+
+                                // No need to reapply the sort, DirList keeps both new and cached listings sorted
                             }
-                            else if (FS::ChangeDirNext(data.entries[i].name, data.entries)) {
-                                if ((data.checkbox_data.count > 1) && (data.checkbox_data.checked_copy.empty()))
-                                    data.checkbox_data.checked_copy = data.checkbox_data.checked;
-                                
-                                data.checkbox_data.checked.resize(data.entries.size());
+                            else {
+                                std::string path = FS::BuildPath(data.entries[i]);
+                            
+                                switch (data.entries[i].file_type) {
+                                    case FileTypeImage:
+                                        if (Textures::LoadImageFile(path, data.textures))
+                                            data.state = WINDOW_STATE_IMAGEVIEWER;
+                                        break;
+
+                                    default:
+                                        break;
+                                }
                             }
+                        }
 
-                            // Reset navigation ID -- TODO: Scroll to top
-                            ImGuiContext& g = *GImGui;
-                            ImGui::SetNavID(ImGui::GetID(data.entries[0].name, 0), g.NavLayer, 0, ImRect());
+                        if (ImGui::IsItemHovered())
+                            data.selected = i;
 
-                            // Reapply sort
-                            ImGuiTableSortSpecs *sorts_specs = ImGui::TableGetSortSpecs();
-                            sorts_specs->SpecsDirty = true;
+                        ImGui::TableNextColumn();
+                        if ((data.entries[i].type == FsDirEntryType_File) && (data.entries[i].flags & DirEntryFlagSize)) {
+                            char size_str[16];
+                            Utils::GetSizeString(size_str, static_cast<double>(data.entries[i].file_size));
+                            ImGui::TextUnformatted(size_str);
                         }
-                        else {
-                            std::string path = FS::BuildPath(data.entries[i]);
-                            
-                            switch (file_type) {
-                                case FileTypeImage:
-                                    if (Textures::LoadImageFile(path, data.textures))
-                                        data.state = WINDOW_STATE_IMAGEVIEWER;
-                                    break;
-
-                                default:
-                                    break;
-                            }
+
+                        ImGui::TableNextColumn();
+                        if ((data.entries[i].flags & DirEntryFlagTime) && (data.entries[i].modified != 0)) {
+                            char date_str[36];
+                            std::strftime(date_str, sizeof(date_str), "%Y/%m/%d %H:%M", std::localtime(std::addressof(data.entries[i].modified)));
+                            ImGui::TextUnformatted(date_str);
                         }
                     }
-
-                    if (ImGui::IsItemHovered())
-                        data.selected = i;
                 }
 
                 ImGui::EndTable();
@@ -0,0 +1,108 @@
+#include "config.hpp"
+#include "imgui.h"
+#include "keyboard.hpp"
+#include "language.hpp"
+#include "search.hpp"
+#include "tabs.hpp"
+#include "textures.hpp"
+
+namespace Tabs {
+    static const ImVec2 search_tex_size = ImVec2(21, 21);
+    static std::string search_device = "sdmc:", search_query = std::string();
+
+    // Device the results came from, the combo can change while they're still listed.
+    static std::string results_device = std::string();
+    static std::vector<SearchResult> search_results;
+
+    void Search(WindowData &data) {
+        if (ImGui::BeginTabItem("Search")) {
+            ImGui::Dummy(ImVec2(0.0f, 1.0f)); // Spacing
+
+            ImGui::PushID("search_device_list");
+            ImGui::PushItemWidth(160.f);
+            if (ImGui::BeginCombo("", search_device.c_str())) {
+                std::scoped_lock lock(devices_list_mutex);
+
+                for (std::size_t i = 0; i < devices_list.size(); i++) {
+                    const bool is_selected = (search_device == devices_list[i]);
+
+                    if (ImGui::Selectable(devices_list[i].c_str(), is_selected))
+                        search_device = devices_list[i];
+                    
+                    if (is_selected)
+                        ImGui::SetItemDefaultFocus();
+                }
+
+                ImGui::EndCombo();
+            }
+            ImGui::PopItemWidth();
+            ImGui::PopID();
+
+            ImGui::SameLine();
+
+            if (ImGui::Button(strings[cfg.lang][Lang::SearchButton])) {
+                std::string text = Keyboard::GetText(strings[cfg.lang][Lang::SearchPrompt], search_query);
+                if (!text.empty()) {
+                    search_query = text;
+                    search_results.clear();
+                    results_device = search_device;
+                    Search::Start(search_device, search_query);
+                }
+            }
+
+            if (Search::Busy()) {
+                ImGui::SameLine();
+
+                if (ImGui::Button(strings[cfg.lang][Lang::ButtonCancel]))
+                    Search::Cancel();
+            }
+
+            // Matches show up as the worker threads find them, no need to wait for the whole device
+            Search::Poll(search_results);
+
+            ImGui::SameLine();
+            ImGui::Text(strings[cfg.lang][Lang::SearchStatus], search_results.size(), Search::GetFolderCount());
+            ImGui::Dummy(ImVec2(0.0f, 1.0f)); // Spacing
+
+            ImGuiTableFlags tableFlags = ImGuiTableFlags_Resizable | ImGuiTableFlags_BordersInner | ImGuiTableFlags_BordersOuter |
+                ImGuiTableFlags_SizingStretchProp | ImGuiTableFlags_ScrollY;
+            
+            if (ImGui::BeginTable("Search Results", 2, tableFlags)) {
+                ImGui::TableSetupColumn("Filename");
+                ImGui::TableSetupColumn("Folder");
+                ImGui::TableHeadersRow();
+
+                ImGuiListClipper clipper;
+                clipper.Begin(static_cast<int>(search_results.size()));
+
+                while (clipper.Step()) {
+                    for (int row = clipper.DisplayStart; row < clipper.DisplayEnd; row++) {
+                        const SearchResult &result = search_results[row];
+
+                        ImGui::TableNextRow();
+
+                        ImGui::TableNextColumn();
+                        if (result.type == FsDirEntryType_Dir)
+                            ImGui::Image(reinterpret_cast<ImTextureID>(folder_icon.id), search_tex_size);
+                        else
+                            ImGui::Image(reinterpret_cast<ImTextureID>(file_icons[result.file_type].id), search_tex_size);
+                        
+                        ImGui::SameLine();
+
+                        ImGui::PushID(row);
+                        if (ImGui::Selectable(result.name.c_str(), false, ImGuiSelectableFlags_SpanAllColumns))
+                            Tabs::OpenFolder(data, results_device, result.path);
+                        ImGui::PopID();
+
+                        ImGui::TableNextColumn();
+                        ImGui::TextUnformatted(result.path.c_str());
+                    }
+                }
+
+                ImGui::EndTable();
+            }
+            
+            ImGui::EndTabItem();
+        }
+    }
+}
@@ -8,6 +8,7 @@
 #include "net.hpp"
 #include "popups.hpp"
 #include "tabs.hpp"
+#include "transfer.hpp"
 #include "usb.hpp"
 
 namespace Tabs {
@@ -81,6 +82,32 @@ namespace Tabs {
 
             Tabs::Separator();
 
+            // Sort settings
+            Tabs::Indent(strings[cfg.lang][Lang::SettingsSortTitle]);
+
+            if (ImGui::Checkbox(strings[cfg.lang][Lang::SettingsSortNaturalToggle], std::addressof(cfg.natural_sort))) {
+                Config::Save(cfg);
+                sort = -1;
+            }
+
+            Tabs::Separator();
+
+            // Copy verification, read back after each file is written
+            Tabs::Indent(strings[cfg.lang][Lang::SettingsCopyTitle]);
+
+            if (ImGui::RadioButton(strings[cfg.lang][Lang::SettingsCopyVerifyNone], std::addressof(cfg.verify_copies), TransferVerifyNone))
+                Config::Save(cfg);
+            
+            ImGui::SameLine();
+            if (ImGui::RadioButton(" CRC32C", std::addressof(cfg.verify_copies), TransferVerifyCRC32C))
+                Config::Save(cfg);
+            
+            ImGui::SameLine();
+            if (ImGui::RadioButton(" SHA-256", std::addressof(cfg.verify_copies), TransferVerifySHA256))
+                Config::Save(cfg);
+
+            Tabs::Separator();
+
             // Image filename checkbox
             Tabs::Indent(strings[cfg.lang][Lang::SettingsImageViewTitle]);
 
@@ -0,0 +1,1381 @@
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <dirent.h>
+#include <iterator>
+#include <map>
+#include <mutex>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "config.hpp"
+#include "fs.hpp"
+#include "journal.hpp"
+#include "log.hpp"
+#include "transfer.hpp"
+#include "usb.hpp"
+#include "utils.hpp"
+
+namespace Transfer {
+    // Block sizes a copy can pick from. The ring is allocated once per run of the thread for the
+    // largest one, so it never grows past copy_block_count * 2 MiB and switching sizes doesn't reallocate.
+    static constexpr std::size_t copy_block_sizes[] = { 0x10000, 0x20000, 0x40000, 0x80000, 0x100000, 0x200000 };
+    static constexpr std::size_t copy_block_sizes_count = std::size(copy_block_sizes);
+    static constexpr std::size_t copy_block_default = 4;
+    static constexpr std::size_t copy_block_count = 4;
+    static constexpr std::size_t copy_block_align = 0x1000;
+    static constexpr std::size_t copy_blocks_size = copy_block_sizes[copy_block_sizes_count - 1] * copy_block_count;
+
+    // A file has to span this many blocks before its throughput says anything about the block size.
+    static constexpr u64 copy_block_min_sample = 8;
+
+    // Anything bigger doesn't fit in one file on FAT. Split files use the same part size Horizon does
+    // for its concatenation files, so a folder of parts copied to the SD card only needs the archive bit.
+    static constexpr u64 fat_file_size_max = 0xFFFFFFFF;
+    static constexpr u64 split_part_size = 0xFFFF0000;
+
+    // Files up to this size in a folder copy go to a few worker threads, so the time spent opening,
+    // creating and closing files overlaps. Anything bigger is streamed through the ring by the transfer thread.
+    static constexpr int small_copy_threads_max = 3;
+    static constexpr u64 small_file_size_max = 0x40000;
+    static constexpr std::size_t small_copy_queue_max = 64;
+
+    // How much of a file gets written between the destination being flushed and the offset journalled.
+    static constexpr u64 journal_interval = 0x4000000;
+
+    // Streamed copies are written under this suffix and only renamed once they're complete and verified, so a
+    // file that's still being copied, or left behind to be resumed, never looks finished. Split files get a folder.
+    static constexpr const char *temp_suffix = ".nxpart";
+
+    typedef struct {
+        std::string src_path;
+        std::string dest_path;
+        std::string name;
+        u64 src_mtime = 0;
+    } SmallCopyJob;
+
+    typedef struct {
+        std::mutex mutex;
+        std::condition_variable cond;
+        std::deque<SmallCopyJob> jobs;
+        Thread threads[small_copy_threads_max];
+        int threads_created = 0;
+        int verify = TransferVerifyNone;
+        bool done = false, failed = false;
+    } SmallCopyPool;
+
+    // Measured throughput of each block size for one source/destination device pair, in bytes per ns.
+    // Unmeasured sizes are 0, the index is the size copies between the pair currently use.
+    typedef struct {
+        std::size_t index = copy_block_default;
+        double rates[copy_block_sizes_count] = { 0 };
+    } BlockTuner;
+
+    typedef struct {
+        unsigned char *blocks = nullptr;
+        BlockTuner *tuner = nullptr;
+        SmallCopyPool *pool = nullptr;
+        int verify = TransferVerifyNone;
+        bool split = false, failed = false;
+    } CopyState;
+
+    // Running checksum of what a copy read from the source, to check the destination against once it's written.
+    typedef struct {
+        int mode = TransferVerifyNone;
+        u32 crc = 0;
+        Sha256Context sha256;
+    } CopyDigest;
+
+    static std::mutex tuners_mutex;
+    static std::map<std::string, BlockTuner> tuners;
+    static bool tuners_loaded = false, tuners_changed = false;
+
+    // The thread is started by the UI and stopped by the UI or the USB thread when a drive goes away,
+    // thread_mutex keeps the two from handling it at the same time.
+    static std::mutex thread_mutex;
+    static Thread thread = {0};
+    static bool thread_created = false, running = false;
+    static std::atomic<bool> cancel = false, suspend = false;
+    static std::atomic<u64> progress_offset = 0, progress_size = 0;
+
+    // Bytes written and files finished by the current job and since the thread last started. They're only
+    // ever added to by the thread and sampled by the UI once a frame, which works out the rates from them.
+    static std::atomic<u64> job_offset = 0, job_size = 0, bytes_done = 0, files_done = 0;
+
+    // Throughput as the UI last sampled it, only touched by the UI thread.
+    static constexpr u64 rate_sample_interval = 500000000;
+    static u64 rate_tick = 0, rate_bytes = 0, rate_files = 0;
+    static double bytes_rate = 0.0, files_rate = 0.0;
+
+    // Jobs waiting for the thread, and the state it's running in, guarded by queue_mutex. skip suspends
+    // only the job being copied, the thread goes on with the queue and clears it once that job is done.
+    static std::mutex queue_mutex;
+    static std::condition_variable skip_cond;
+    static std::deque<TransferJob> queue;
+    static TransferJob running_job;
+    static bool skip = false;
+
+    static std::mutex progress_mutex;
+    static std::string progress_name;
+
+    static std::mutex finished_mutex;
+    static std::vector<TransferJob> finished;
+
+    static void SetProgressName(const char *name) {
+        std::scoped_lock lock(progress_mutex);
+        progress_name = name;
+    }
+
+    // One end of a copy. Files on the Nintendo filesystems are read and written through FsFile
+    // directly, stdio is only used for the USB drives, which we don't have an FsFileSystem for.
+    // A split destination is a folder of parts, part_size is 0 for a plain file.
+    typedef struct {
+        FsFile fs_file;
+        FILE *file = nullptr;
+        bool native = false;
+        s64 offset = 0;
+        std::string path;
+        u64 size = 0, part_size = 0, part_offset = 0;
+        u32 part = 0;
+    } CopyHandle;
+
+    static FsFileSystem *GetFileSystem(const char *path, const char **fs_path) {
+        const char *colon = std::strchr(path, ':');
+        if (!colon)
+            return nullptr;
+        
+        *fs_path = colon + 1;
+        return FS::GetFileSystem(std::string(path, colon + 1));
+    }
+
+    static bool OpenSource(CopyHandle &handle, const char *path, s64 &size) {
+        Result ret = 0;
+        const char *fs_path = nullptr;
+        FsFileSystem *filesystem = Transfer::GetFileSystem(path, std::addressof(fs_path));
+
+        if (filesystem) {
+            if (R_FAILED(ret = fsFsOpenFile(filesystem, fs_path, FsOpenMode_Read, std::addressof(handle.fs_file)))) {
+                Log::Error("Transfer::OpenSource fsFsOpenFile(%s) failed: 0x%x\n", path, ret);
+                return false;
+            }
+
+            if (R_FAILED(ret = fsFileGetSize(std::addressof(handle.fs_file), std::addressof(size)))) {
+                Log::Error("Transfer::OpenSource fsFileGetSize(%s) failed: 0x%x\n", path, ret);
+                fsFileClose(std::addressof(handle.fs_file));
+                return false;
+            }
+
+            handle.native = true;
+            return true;
+        }
+
+        struct stat file_stat = { 0 };
+        if (stat(path, std::addressof(file_stat)) != 0) {
+            Log::Error("Transfer::OpenSource (%s) failed to get src file size.\n", path);
+            return false;
+        }
+
+        if (!(handle.file = fopen(path, "rb"))) {
+            Log::Error("Transfer::OpenSource (%s) failed to open src file.\n", path);
+            return false;
+        }
+
+        // The blocks are big enough, stdio buffering would only add a copy
+        setvbuf(handle.file, nullptr, _IONBF, 0);
+        size = file_stat.st_size;
+        return true;
+    }
+
+    // Removes a split file's parts, as many as there turn out to be, and then its folder if that leaves it empty.
+    static void RemoveParts(const char *path) {
+        char part_path[FS_MAX_PATH];
+
+        for (u32 part = 0; ; part++) {
+            std::snprintf(part_path, FS_MAX_PATH, "%s/%02u", path, part);
+            if (remove(part_path) != 0)
+                break;
+        }
+
+        rmdir(path);
+    }
+
+    // Parts are sized up front like native files are. FAT only allocates clusters for that, it doesn't write them.
+    static bool OpenPart(CopyHandle &handle, u32 part) {
+        char part_path[FS_MAX_PATH];
+        std::snprintf(part_path, FS_MAX_PATH, "%s/%02u", handle.path.c_str(), part);
+
+        if (!(handle.file = fopen(part_path, "wb"))) {
+            Log::Error("Transfer::OpenPart (%s) failed to open dest file.\n", part_path);
+            return false;
+        }
+
+        setvbuf(handle.file, nullptr, _IONBF, 0);
+        handle.part = part;
+        handle.part_offset = 0;
+
+        const u64 part_length = std::min(handle.part_size, handle.size - (part * handle.part_size));
+        if (ftruncate(fileno(handle.file), static_cast<off_t>(part_length)) != 0)
+            Log::Error("Transfer::OpenPart (%s) failed to preallocate %lu bytes.\n", part_path, part_length);
+        
+        return true;
+    }
+
+    // Native destinations are created at their final size up front, so the file isn't grown (and its
+    // allocation and metadata updated) with every block that's written. Files too big for FAT are
+    // created as concatenation files on the Nintendo filesystems and split into parts on FAT USB drives.
+    // On failure only what was created here is removed again, the caller has nothing to clean up.
+    // path is the temporary one, anything left there by an earlier copy is replaced.
+    static bool OpenDest(CopyHandle &handle, const char *path, s64 size, bool &split) {
+        Result ret = 0;
+        const char *fs_path = nullptr;
+        FsFileSystem *filesystem = Transfer::GetFileSystem(path, std::addressof(fs_path));
+
+        if (filesystem) {
+            // We don't care if there was none.
+            fsFsDeleteFile(filesystem, fs_path);
+
+            const u32 option = (static_cast<u64>(size) > fat_file_size_max)? FsCreateOption_BigFile : 0;
+            if (R_FAILED(ret = fsFsCreateFile(filesystem, fs_path, size, option))) {
+                Log::Error("Transfer::OpenDest fsFsCreateFile(%s) failed: 0x%x\n", path, ret);
+                return false;
+            }
+
+            if (R_FAILED(ret = fsFsOpenFile(filesystem, fs_path, FsOpenMode_Write, std::addressof(handle.fs_file)))) {
+                Log::Error("Transfer::OpenDest fsFsOpenFile(%s) failed: 0x%x\n", path, ret);
+                fsFsDeleteFile(filesystem, fs_path);
+                return false;
+            }
+
+            handle.native = true;
+            return true;
+        }
+
+        const char *colon = std::strchr(path, ':');
+        const u64 limit = colon? USB::GetFileSizeLimit(std::string(path, colon + 1)) : 0;
+
+        if ((limit != 0) && (static_cast<u64>(size) > limit)) {
+            remove(path);
+            Transfer::RemoveParts(path);
+
+            if ((mkdir(path, 0700) != 0) && (errno != EEXIST)) {
+                Log::Error("Transfer::OpenDest (%s) failed to create split file folder.\n", path);
+                return false;
+            }
+
+            handle.path = path;
+            handle.size = size;
+            handle.part_size = split_part_size;
+            split = true;
+
+            if (!Transfer::OpenPart(handle, 0)) {
+                rmdir(path);
+                return false;
+            }
+
+            return true;
+        }
+
+        if (!(handle.file = fopen(path, "wb"))) {
+            Log::Error("Transfer::OpenDest (%s) failed to open dest file.\n", path);
+            return false;
+        }
+
+        setvbuf(handle.file, nullptr, _IONBF, 0);
+        return true;
+    }
+
+    // Opens what an interrupted copy left behind to carry on from offset. It has to be laid out the way
+    // OpenDest would lay out the same file now, anything else and the copy starts over.
+    static bool ResumeDest(CopyHandle &handle, const char *path, s64 size, s64 offset, bool &split) {
+        const char *fs_path = nullptr;
+        FsFileSystem *filesystem = Transfer::GetFileSystem(path, std::addressof(fs_path));
+
+        if (filesystem) {
+            s64 dest_size = 0;
+
+            if (R_FAILED(fsFsOpenFile(filesystem, fs_path, FsOpenMode_Write, std::addressof(handle.fs_file))))
+                return false;
+            
+            if ((R_FAILED(fsFileGetSize(std::addressof(handle.fs_file), std::addressof(dest_size)))) || (dest_size != size)) {
+                fsFileClose(std::addressof(handle.fs_file));
+                return false;
+            }
+
+            handle.native = true;
+            handle.offset = offset;
+            return true;
+        }
+
+        const char *colon = std::strchr(path, ':');
+        const u64 limit = colon? USB::GetFileSizeLimit(std::string(path, colon + 1)) : 0;
+
+        char part_path[FS_MAX_PATH];
+        std::snprintf(part_path, FS_MAX_PATH, "%s", path);
+        s64 part_offset = offset;
+
+        if ((limit != 0) && (static_cast<u64>(size) > limit)) {
+            handle.path = path;
+            handle.size = size;
+            handle.part_size = split_part_size;
+            handle.part = static_cast<u32>(offset / split_part_size);
+            part_offset = offset % split_part_size;
+            std::snprintf(part_path, FS_MAX_PATH, "%s/%02u", path, handle.part);
+            split = true;
+        }
+
+        struct stat file_stat = { 0 };
+        if ((stat(part_path, std::addressof(file_stat)) != 0) || (file_stat.st_size < part_offset))
+            return false;
+        
+        if (!(handle.file = fopen(part_path, "r+b")))
+            return false;
+        
+        setvbuf(handle.file, nullptr, _IONBF, 0);
+
+        if (fseek(handle.file, part_offset, SEEK_SET) != 0) {
+            fclose(handle.file);
+            handle.file = nullptr;
+            return false;
+        }
+
+        handle.part_offset = part_offset;
+        return true;
+    }
+
+    static bool ReadBlock(CopyHandle &handle, unsigned char *buf, std::size_t size, std::size_t &bytes_read) {
+        if (handle.native) {
+            Result ret = 0;
+            u64 length = 0;
+
+            if (R_FAILED(ret = fsFileRead(std::addressof(handle.fs_file), handle.offset, buf, size, FsReadOption_None, std::addressof(length)))) {
+                Log::Error("Transfer::ReadBlock fsFileRead() failed: 0x%x\n", ret);
+                return false;
+            }
+
+            handle.offset += length;
+            bytes_read = length;
+            return true;
+        }
+
+        bytes_read = fread(buf, sizeof(unsigned char), size, handle.file);
+        return ((bytes_read == size) || (!ferror(handle.file)));
+    }
+
+    static bool WriteBlock(CopyHandle &handle, const unsigned char *buf, std::size_t size) {
+        if (handle.native) {
+            Result ret = 0;
+
+            if (R_FAILED(ret = fsFileWrite(std::addressof(handle.fs_file), handle.offset, buf, size, FsWriteOption_None))) {
+                Log::Error("Transfer::WriteBlock fsFileWrite() failed: 0x%x\n", ret);
+                return false;
+            }
+
+            handle.offset += size;
+            return true;
+        }
+
+        if (handle.part_size == 0)
+            return (fwrite(buf, sizeof(unsigned char), size, handle.file) == size);
+        
+        // A block can straddle two parts
+        while (size > 0) {
+            if (handle.part_offset == handle.part_size) {
+                int closed = fclose(handle.file);
+                handle.file = nullptr;
+
+                if ((closed != 0) || (!Transfer::OpenPart(handle, handle.part + 1)))
+                    return false;
+            }
+
+            const std::size_t length = static_cast<std::size_t>(std::min<u64>(size, handle.part_size - handle.part_offset));
+            if (fwrite(buf, sizeof(unsigned char), length, handle.file) != length)
+                return false;
+            
+            handle.part_offset += length;
+            buf += length;
+            size -= length;
+        }
+
+        return true;
+    }
+
+    // Everything written so far has to be on the device before its offset goes in the journal.
+    static bool FlushHandle(CopyHandle &handle) {
+        Result ret = 0;
+
+        if (!handle.native)
+            return ((handle.file) && (fflush(handle.file) == 0) && (fsync(fileno(handle.file)) == 0));
+        
+        if (R_FAILED(ret = fsFileFlush(std::addressof(handle.fs_file)))) {
+            Log::Error("Transfer::FlushHandle fsFileFlush() failed: 0x%x\n", ret);
+            return false;
+        }
+
+        return true;
+    }
+
+    // A native destination is flushed once here rather than on every write.
+    static bool CloseHandle(CopyHandle &handle, bool flush) {
+        Result ret = 0;
+
+        if (!handle.native)
+            return ((handle.file) && (fclose(handle.file) == 0));
+        
+        if ((flush) && (R_FAILED(ret = fsFileFlush(std::addressof(handle.fs_file)))))
+            Log::Error("Transfer::CloseHandle fsFileFlush() failed: 0x%x\n", ret);
+        
+        fsFileClose(std::addressof(handle.fs_file));
+        return R_SUCCEEDED(ret);
+    }
+
+    static void RemoveDest(const CopyHandle &handle, const char *path) {
+        if (handle.part_size == 0)
+            remove(path);
+        else
+            Transfer::RemoveParts(path);
+    }
+
+    // Moves a finished copy from its temporary name to its own, replacing whatever was there.
+    static bool CommitDest(const CopyHandle &handle, const char *temp_path, const char *path) {
+        Result ret = 0;
+        const char *fs_path = nullptr, *fs_temp_path = nullptr;
+        FsFileSystem *filesystem = Transfer::GetFileSystem(path, std::addressof(fs_path));
+
+        if ((filesystem) && (Transfer::GetFileSystem(temp_path, std::addressof(fs_temp_path)) == filesystem)) {
+            // We don't care if there was none.
+            fsFsDeleteFile(filesystem, fs_path);
+
+            if (R_FAILED(ret = fsFsRenameFile(filesystem, fs_temp_path, fs_path))) {
+                Log::Error("Transfer::CommitDest fsFsRenameFile(%s) failed: 0x%x\n", path, ret);
+                return false;
+            }
+
+            return true;
+        }
+
+        // A folder is only cleared out for a split file, which would have left one
+        struct stat file_stat = { 0 };
+        if (stat(path, std::addressof(file_stat)) == 0) {
+            if (!S_ISDIR(file_stat.st_mode))
+                remove(path);
+            else if (handle.part_size != 0)
+                Transfer::RemoveParts(path);
+        }
+
+        if (rename(temp_path, path) != 0) {
+            Log::Error("Transfer::CommitDest (%s) failed to rename to %s.\n", temp_path, path);
+            return false;
+        }
+
+        return true;
+    }
+
+    static void DigestInit(CopyDigest &digest, int mode) {
+        digest.mode = mode;
+        digest.crc = 0;
+
+        if (mode == TransferVerifySHA256)
+            sha256ContextCreate(std::addressof(digest.sha256));
+    }
+
+    static void DigestUpdate(CopyDigest &digest, const unsigned char *buf, std::size_t size) {
+        if (digest.mode == TransferVerifyCRC32C)
+            digest.crc = Utils::CRC32C(digest.crc, buf, size);
+        else if (digest.mode == TransferVerifySHA256)
+            sha256ContextUpdate(std::addressof(digest.sha256), buf, size);
+    }
+
+    static void DigestFinish(CopyDigest &digest, u8 hash[SHA256_HASH_SIZE]) {
+        std::memset(hash, 0, SHA256_HASH_SIZE);
+
+        if (digest.mode == TransferVerifyCRC32C)
+            std::memcpy(hash, std::addressof(digest.crc), sizeof(digest.crc));
+        else if (digest.mode == TransferVerifySHA256)
+            sha256ContextGetHash(std::addressof(digest.sha256), hash);
+    }
+
+    // Reads the destination back, a split one part by part, and checks it against the source's digest.
+    static bool VerifyDest(const CopyHandle &dest, const char *path, CopyDigest &digest, unsigned char *buf, std::size_t buf_size) {
+        CopyDigest check;
+        Transfer::DigestInit(check, digest.mode);
+
+        char part_path[FS_MAX_PATH];
+        const u32 parts = (dest.part_size != 0)? dest.part + 1 : 1;
+
+        for (u32 part = 0; part < parts; part++) {
+            if (dest.part_size != 0)
+                std::snprintf(part_path, FS_MAX_PATH, "%s/%02u", path, part);
+            else
+                std::snprintf(part_path, FS_MAX_PATH, "%s", path);
+            
+            CopyHandle handle;
+            s64 size = 0;
+
+            if (!Transfer::OpenSource(handle, part_path, size))
+                return false;
+            
+            bool ret = true;
+            std::size_t length = 0;
+
+            while ((!cancel) && (ret = Transfer::ReadBlock(handle, buf, buf_size, length)) && (length != 0))
+                Transfer::DigestUpdate(check, buf, length);
+            
+            Transfer::CloseHandle(handle, false);
+
+            if ((!ret) || (cancel))
+                return false;
+        }
+
+        u8 expected[SHA256_HASH_SIZE], actual[SHA256_HASH_SIZE];
+        Transfer::DigestFinish(digest, expected);
+        Transfer::DigestFinish(check, actual);
+
+        if (std::memcmp(expected, actual, SHA256_HASH_SIZE) != 0) {
+            Log::Error("Transfer::VerifyDest (%s) doesn't match its source.\n", path);
+            return false;
+        }
+
+        return true;
+    }
+
+    // Starts reading the source at offset. With verification on, the part that's already been copied
+    // has to go into the digest too, so it's read rather than skipped.
+    static bool SkipSource(CopyHandle &handle, s64 offset, CopyDigest *digest, unsigned char *buf, std::size_t buf_size) {
+        if (!digest) {
+            if (handle.native) {
+                handle.offset = offset;
+                return true;
+            }
+
+            return (fseek(handle.file, offset, SEEK_SET) == 0);
+        }
+
+        while ((offset > 0) && (!cancel)) {
+            std::size_t length = 0;
+            if ((!Transfer::ReadBlock(handle, buf, static_cast<std::size_t>(std::min<s64>(buf_size, offset)), length)) || (length == 0))
+                return false;
+            
+            Transfer::DigestUpdate(*digest, buf, length);
+            offset -= length;
+        }
+
+        return (offset == 0);
+    }
+
+    // Reads the source into one block while the previous ones are written out, so neither device waits on the other.
+    typedef struct {
+        std::mutex mutex;
+        std::condition_variable cond;
+        CopyHandle *src = nullptr;
+        CopyDigest *digest = nullptr;
+        unsigned char *blocks = nullptr;
+        std::size_t block_size = 0;
+        std::size_t lengths[copy_block_count] = { 0 };
+        std::size_t head = 0, tail = 0, filled = 0;
+        bool eof = false, error = false, abort = false;
+    } CopyPipe;
+
+    static void ReaderThreadFunc(void *arg) {
+        CopyPipe *pipe = static_cast<CopyPipe *>(arg);
+
+        while (true) {
+            std::size_t head = 0;
+
+            {
+                std::unique_lock lock(pipe->mutex);
+                pipe->cond.wait(lock, [pipe]() { return ((pipe->filled < copy_block_count) || (pipe->abort)); });
+
+                if (pipe->abort)
+                    return;
+
+                head = pipe->head;
+            }
+
+            // The block at head belongs to us until it's counted as filled
+            std::size_t bytes_read = 0;
+            bool error = !Transfer::ReadBlock(*pipe->src, pipe->blocks + (head * pipe->block_size), pipe->block_size, bytes_read);
+
+            // Checksummed here so it overlaps with the writes too
+            if ((!error) && (pipe->digest))
+                Transfer::DigestUpdate(*pipe->digest, pipe->blocks + (head * pipe->block_size), bytes_read);
+
+            {
+                std::scoped_lock lock(pipe->mutex);
+                pipe->lengths[head] = bytes_read;
+                pipe->head = (head + 1) % copy_block_count;
+                pipe->filled++;
+                pipe->eof = (bytes_read < pipe->block_size);
+                pipe->error = error;
+            }
+
+            pipe->cond.notify_all();
+
+            if (bytes_read < pipe->block_size)
+                return;
+        }
+    }
+
+    // Writes the blocks the reader thread filled, in order. Without a reader thread the same loop reads them itself.
+    // Every journal_interval bytes the destination is flushed and the offset journalled, so an
+    // interrupted copy can carry on from there.
+    static bool WriteBlocks(CopyPipe &pipe, CopyHandle &dest, const char *dest_path, const Journal::Source &source, u64 offset, bool threaded) {
+        u64 checkpoint = offset;
+
+        while (true) {
+            std::size_t tail = 0, length = 0;
+
+            if (cancel)
+                return false;
+
+            if (!threaded) {
+                if (!Transfer::ReadBlock(*pipe.src, pipe.blocks, pipe.block_size, length))
+                    return false;
+                
+                if (pipe.digest)
+                    Transfer::DigestUpdate(*pipe.digest, pipe.blocks, length);
+                
+                pipe.eof = (length < pipe.block_size);
+            }
+            else {
+                std::unique_lock lock(pipe.mutex);
+                pipe.cond.wait(lock, [&pipe]() { return (pipe.filled > 0); });
+
+                tail = pipe.tail;
+                length = pipe.lengths[tail];
+
+                if ((pipe.error) && (pipe.filled == 1))
+                    return false;
+            }
+
+            if ((length != 0) && (!Transfer::WriteBlock(dest, pipe.blocks + (tail * pipe.block_size), length)))
+                return false;
+
+            offset += length;
+            progress_offset = offset;
+            job_offset += length;
+            bytes_done += length;
+
+            if ((offset - checkpoint >= journal_interval) && (Transfer::FlushHandle(dest))) {
+                Journal::SetOffset(dest_path, source, offset);
+                checkpoint = offset;
+            }
+
+            if (threaded) {
+                {
+                    std::scoped_lock lock(pipe.mutex);
+                    pipe.tail = (tail + 1) % copy_block_count;
+                    pipe.filled--;
+
+                    if ((pipe.eof) && (pipe.filled == 0))
+                        return true;
+                }
+
+                pipe.cond.notify_all();
+            }
+            else if (pipe.eof)
+                return true;
+        }
+    }
+
+    // Folds a file's throughput into the pair's measurements and picks the size for the next file. It keeps
+    // trying the next size in the direction that got faster, then settles on the fastest of the neighbours.
+    static void TuneBlockSize(BlockTuner &tuner, std::size_t index, u64 size, u64 ns) {
+        if ((size < copy_block_sizes[index] * copy_block_min_sample) || (ns == 0))
+            return;
+        
+        const double rate = static_cast<double>(size) / static_cast<double>(ns);
+        std::scoped_lock lock(tuners_mutex);
+        tuner.rates[index] = (tuner.rates[index] == 0.0)? rate : ((tuner.rates[index] * 0.75) + (rate * 0.25));
+
+        const bool has_up = (index + 1 < copy_block_sizes_count), has_down = (index > 0);
+        const double up = has_up? tuner.rates[index + 1] : 0.0, down = has_down? tuner.rates[index - 1] : 0.0;
+        std::size_t next = index;
+
+        if ((has_up) && (up == 0.0) && (down <= tuner.rates[index]))
+            next = index + 1;
+        else if ((has_down) && (down == 0.0) && (up <= tuner.rates[index]))
+            next = index - 1;
+        else if ((up > tuner.rates[index]) && (up >= down))
+            next = index + 1;
+        else if (down > tuner.rates[index])
+            next = index - 1;
+
+        if (next != tuner.index) {
+            tuner.index = next;
+            tuners_changed = true;
+        }
+    }
+
+    // Checks for a cancel after every block, a partly written file is removed again unless it can be resumed.
+    // The journal keeps to dest_path, the data goes to its temporary name until the copy is complete.
+    static bool CopyFile(const char *src_path, const char *dest_path, const char *filename, u64 src_mtime, CopyState &state) {
+        CopyPipe pipe;
+        pipe.blocks = state.blocks;
+
+        std::size_t index = 0;
+        {
+            std::scoped_lock lock(tuners_mutex);
+            index = state.tuner->index;
+        }
+
+        pipe.block_size = copy_block_sizes[index];
+
+        CopyHandle src, dest;
+        s64 size = 0;
+        pipe.src = std::addressof(src);
+
+        CopyDigest digest;
+        Transfer::DigestInit(digest, state.verify);
+        pipe.digest = (state.verify != TransferVerifyNone)? std::addressof(digest) : nullptr;
+
+        if (!Transfer::OpenSource(src, src_path, size))
+            return false;
+
+        const Journal::Source source = { size, src_mtime };
+        const std::string temp_path = std::string(dest_path) + temp_suffix;
+
+        // Picks up where the journal says an earlier copy of this file got to, if the source hasn't changed since
+        s64 offset = Journal::GetOffset(dest_path, source);
+        state.split = false;
+
+        if ((offset <= 0) || (offset >= size) || (!Transfer::ResumeDest(dest, temp_path.c_str(), size, offset, state.split))) {
+            dest = CopyHandle();
+            offset = 0;
+            state.split = false;
+
+            if (!Transfer::OpenDest(dest, temp_path.c_str(), size, state.split)) {
+                Transfer::CloseHandle(src, false);
+                return false;
+            }
+        }
+
+        Transfer::SetProgressName(filename);
+        progress_offset = offset;
+        progress_size = size;
+        job_offset += offset;
+
+        if ((offset != 0) && (!Transfer::SkipSource(src, offset, pipe.digest, state.blocks, copy_blocks_size))) {
+            Log::Error("Transfer::CopyFile (%s) failed to resume at %ld.\n", src_path, offset);
+            Transfer::CloseHandle(src, false);
+            Transfer::CloseHandle(dest, false);
+            return false;
+        }
+
+        // Files that fit in one block gain nothing from a second thread
+        Thread reader;
+        bool threaded = false;
+
+        if (static_cast<u64>(size) > pipe.block_size) {
+            Result ret = 0;
+
+            if (R_FAILED(ret = threadCreate(std::addressof(reader), ReaderThreadFunc, std::addressof(pipe), nullptr, 0x10000, 0x2C, -2)))
+                Log::Error("Transfer::CopyFile threadCreate() failed: 0x%x\n", ret);
+            else if (R_FAILED(ret = threadStart(std::addressof(reader)))) {
+                Log::Error("Transfer::CopyFile threadStart() failed: 0x%x\n", ret);
+                threadClose(std::addressof(reader));
+            }
+            else
+                threaded = true;
+        }
+
+        u64 start = armGetSystemTick();
+        bool ret = Transfer::WriteBlocks(pipe, dest, dest_path, source, offset, threaded);
+
+        if (threaded) {
+            {
+                std::scoped_lock lock(pipe.mutex);
+                pipe.abort = true;
+            }
+
+            pipe.cond.notify_all();
+            threadWaitForExit(std::addressof(reader));
+            threadClose(std::addressof(reader));
+        }
+
+        Transfer::CloseHandle(src, false);
+        ret = (Transfer::CloseHandle(dest, ret)) && (ret);
+
+        // The block size is tuned on the copy alone, reading it back doesn't depend on it
+        const u64 ns = armTicksToNs(armGetSystemTick() - start);
+
+        bool verified = true;
+        if ((ret) && (pipe.digest))
+            ret = verified = Transfer::VerifyDest(dest, temp_path.c_str(), digest, state.blocks, copy_blocks_size);
+
+        if (ret)
+            ret = Transfer::CommitDest(dest, temp_path.c_str(), dest_path);
+
+        if (ret) {
+            Transfer::TuneBlockSize(*state.tuner, index, size - offset, ns);
+            Journal::SetDone(dest_path, source);
+            files_done++;
+        }
+        else {
+            if (!cancel)
+                Log::Error("Transfer::CopyFile (%s) failed to copy to %s.\n", src_path, dest_path);
+            
+            // What's been journalled is kept to carry on from, unless the copy was cancelled for good or what's there is bad
+            if ((!verified) || ((cancel) && (!suspend)) || (Journal::GetOffset(dest_path, source) <= 0)) {
+                if (!verified)
+                    Journal::SetOffset(dest_path, source, 0);
+                
+                Transfer::RemoveDest(dest, temp_path.c_str());
+            }
+        }
+        
+        return ret;
+    }
+
+    // Small files are read in one go, there's nothing for a second thread to overlap. They're written
+    // straight to their own name, a rename each would cost about as much as the copy, and nothing they
+    // leave behind is ever resumed or skipped without the journal saying they finished.
+    static bool CopySmallFile(const SmallCopyJob &job, int verify, unsigned char *buf) {
+        CopyHandle src, dest;
+        s64 size = 0;
+        bool split = false;
+
+        CopyDigest digest;
+        Transfer::DigestInit(digest, verify);
+
+        if (!Transfer::OpenSource(src, job.src_path.c_str(), size))
+            return false;
+        
+        if (!Transfer::OpenDest(dest, job.dest_path.c_str(), size, split)) {
+            Transfer::CloseHandle(src, false);
+            return false;
+        }
+
+        Transfer::SetProgressName(job.name.c_str());
+
+        // The file may have grown since it was listed, it's still copied whole
+        bool ret = true;
+        while ((ret) && (!cancel)) {
+            std::size_t length = 0;
+            if ((!(ret = Transfer::ReadBlock(src, buf, small_file_size_max, length))) || (length == 0))
+                break;
+            
+            Transfer::DigestUpdate(digest, buf, length);
+            
+            if (!(ret = Transfer::WriteBlock(dest, buf, length)))
+                break;
+            
+            job_offset += length;
+            bytes_done += length;
+        }
+
+        ret = (ret) && (!cancel);
+        Transfer::CloseHandle(src, false);
+        ret = (Transfer::CloseHandle(dest, ret)) && (ret);
+
+        if ((ret) && (verify != TransferVerifyNone))
+            ret = Transfer::VerifyDest(dest, job.dest_path.c_str(), digest, buf, small_file_size_max);
+
+        if (ret) {
+            Journal::SetDone(job.dest_path, { size, job.src_mtime });
+            files_done++;
+        }
+        else {
+            if (!cancel)
+                Log::Error("Transfer::CopySmallFile (%s) failed to copy to %s.\n", job.src_path.c_str(), job.dest_path.c_str());
+            
+            Transfer::RemoveDest(dest, job.dest_path.c_str());
+        }
+
+        return ret;
+    }
+
+    static void SmallCopyThreadFunc(void *arg) {
+        SmallCopyPool *pool = static_cast<SmallCopyPool *>(arg);
+
+        unsigned char *buf = static_cast<unsigned char *>(std::aligned_alloc(copy_block_align, small_file_size_max));
+        if (!buf)
+            Log::Error("Transfer::SmallCopyThreadFunc failed to allocate copy buffer.\n");
+
+        while (true) {
+            SmallCopyJob job;
+
+            {
+                std::unique_lock lock(pool->mutex);
+                pool->cond.wait(lock, [pool]() { return ((!pool->jobs.empty()) || (pool->done)); });
+
+                if (pool->jobs.empty())
+                    break;
+                
+                job = std::move(pool->jobs.front());
+                pool->jobs.pop_front();
+            }
+
+            // There's room in the queue again
+            pool->cond.notify_all();
+
+            // After a cancel the queue is only drained, so the folder walk waiting on it can finish
+            if ((buf) && (!cancel) && (!Transfer::CopySmallFile(job, pool->verify, buf))) {
+                std::scoped_lock lock(pool->mutex);
+                pool->failed = true;
+            }
+        }
+
+        std::free(buf);
+    }
+
+    static void StartPool(SmallCopyPool &pool) {
+        for (int i = 0; i < small_copy_threads_max; i++) {
+            Result ret = 0;
+
+            if (R_FAILED(ret = threadCreate(std::addressof(pool.threads[pool.threads_created]), SmallCopyThreadFunc, std::addressof(pool), nullptr, 0x10000, 0x2C, -2))) {
+                Log::Error("Transfer::StartPool threadCreate() failed: 0x%x\n", ret);
+                continue;
+            }
+
+            if (R_FAILED(ret = threadStart(std::addressof(pool.threads[pool.threads_created])))) {
+                Log::Error("Transfer::StartPool threadStart() failed: 0x%x\n", ret);
+                threadClose(std::addressof(pool.threads[pool.threads_created]));
+                continue;
+            }
+
+            pool.threads_created++;
+        }
+    }
+
+    // Lets the workers finish what's queued, then waits for them.
+    static void StopPool(SmallCopyPool &pool) {
+        {
+            std::scoped_lock lock(pool.mutex);
+            pool.done = true;
+        }
+
+        pool.cond.notify_all();
+
+        for (int i = 0; i < pool.threads_created; i++) {
+            threadWaitForExit(std::addressof(pool.threads[i]));
+            threadClose(std::addressof(pool.threads[i]));
+        }
+
+        pool.threads_created = 0;
+    }
+
+    // Blocks while the queue is full, so a huge folder doesn't get listed into memory ahead of the copies.
+    static void QueueSmallCopy(SmallCopyPool &pool, SmallCopyJob &&job) {
+        {
+            std::unique_lock lock(pool.mutex);
+            pool.cond.wait(lock, [&pool]() { return (pool.jobs.size() < small_copy_queue_max); });
+            pool.jobs.push_back(std::move(job));
+        }
+
+        pool.cond.notify_all();
+    }
+
+    // Files the journal has as finished from the same source are only skipped if they're still there at the
+    // right size. A split file is a folder, its parts were verified when it was finished.
+    static bool IsCopied(const char *dest_path, const struct stat &src_stat) {
+        struct stat file_stat = { 0 };
+
+        if ((!Journal::IsDone(dest_path, { src_stat.st_size, static_cast<u64>(src_stat.st_mtime) })) || (stat(dest_path, std::addressof(file_stat)) != 0))
+            return false;
+        
+        return ((S_ISDIR(file_stat.st_mode)) || (file_stat.st_size == src_stat.st_size));
+    }
+
+    // Adds up what a folder copy is going to write, so there's a total to show progress and time left against.
+    static void GetDirSize(PathBuilder &path, u64 &size) {
+        DIR *dir = nullptr;
+        struct dirent *entry = nullptr;
+        dir = opendir(path.c_str());
+
+        if (!dir)
+            return;
+
+        while ((!cancel) && (entry = readdir(dir))) {
+            if (FS::IsDotEntry(entry->d_name))
+                continue;
+
+            std::size_t length = path.Push(entry->d_name);
+
+            if (entry->d_type & DT_DIR)
+                Transfer::GetDirSize(path, size);
+            else {
+                struct stat file_stat = { 0 };
+                if (stat(path.c_str(), std::addressof(file_stat)) == 0)
+                    size += file_stat.st_size;
+            }
+
+            path.Pop(length);
+        }
+
+        closedir(dir);
+    }
+
+    static bool CopyDir(PathBuilder &src_path, PathBuilder &dest_path, CopyState &state) {
+        DIR *dir = nullptr;
+        struct dirent *entry = nullptr;
+        dir = opendir(src_path.c_str());
+
+        if (!dir) {
+            Log::Error("Transfer::CopyDir(%s) failed to open path.\n", src_path.c_str());
+            return false;
+        }
+
+        // This may fail or not, but we don't care -> make the dir if it doesn't exist, otherwise continue.
+        mkdir(dest_path.c_str(), 0700);
+
+        while ((!cancel) && (entry = readdir(dir))) {
+            if (FS::IsDotEntry(entry->d_name))
+                continue;
+
+            std::size_t src_length = src_path.Push(entry->d_name);
+            std::size_t dest_length = dest_path.Push(entry->d_name);
+
+            if (entry->d_type & DT_DIR)
+                Transfer::CopyDir(src_path, dest_path, state); // Copy Folder (via recursion)
+            else {
+                struct stat file_stat = { 0 };
+                const bool has_size = (stat(src_path.c_str(), std::addressof(file_stat)) == 0);
+
+                if ((has_size) && (Transfer::IsCopied(dest_path.c_str(), file_stat)))
+                    job_offset += file_stat.st_size;
+                else if ((state.pool) && (has_size) && (static_cast<u64>(file_stat.st_size) <= small_file_size_max))
+                    Transfer::QueueSmallCopy(*state.pool, { src_path.c_str(), dest_path.c_str(), entry->d_name, static_cast<u64>(file_stat.st_mtime) });
+                else if (!Transfer::CopyFile(src_path.c_str(), dest_path.c_str(), entry->d_name, static_cast<u64>(file_stat.st_mtime), state)) // Copy File
+                    state.failed = true;
+            }
+            
+            src_path.Pop(src_length);
+            dest_path.Pop(dest_length);
+        }
+
+        closedir(dir);
+        return (!cancel);
+    }
+
+    static void TransferThreadFunc(void *arg) {
+        (void)arg;
+
+        unsigned char *blocks = static_cast<unsigned char *>(std::aligned_alloc(copy_block_align, copy_blocks_size));
+        if (!blocks)
+            Log::Error("Transfer::TransferThreadFunc failed to allocate copy blocks.\n");
+
+        while (true) {
+            TransferJob job;
+
+            {
+                std::scoped_lock lock(queue_mutex);
+
+                if ((queue.empty()) || (cancel)) {
+                    running = false;
+                    break;
+                }
+
+                job = std::move(queue.front());
+                queue.pop_front();
+                running_job = job;
+            }
+
+            PathBuilder src_path(job.src_path), dest_path(job.dest_device + job.dest_folder);
+            dest_path.Push(job.name);
+
+            CopyState state;
+            state.blocks = blocks;
+            state.verify = job.verify;
+
+            {
+                // Tuners are never erased, so the pointer stays valid for the whole job
+                std::scoped_lock lock(tuners_mutex);
+                state.tuner = std::addressof(tuners[job.src_path.substr(0, job.src_path.find(':') + 1) + ">" + job.dest_device]);
+            }
+
+            u64 size = 0;
+            struct stat src_stat = { 0 };
+            Transfer::SetProgressName(job.name.c_str());
+
+            if (job.type == FsDirEntryType_Dir)
+                Transfer::GetDirSize(src_path, size);
+            else if (stat(src_path.c_str(), std::addressof(src_stat)) == 0)
+                size = src_stat.st_size;
+
+            job_offset = 0;
+            job_size = size;
+
+            // Pasting the same thing again after an interrupted copy carries on with it
+            Journal::Begin(job.src_path, dest_path.c_str(), job.type);
+
+            // Jobs still get handed back when there's no memory to copy with, they just fail
+            if (!blocks)
+                job.success = false;
+            else if (job.type == FsDirEntryType_Dir) {
+                // Without any workers the small files are copied here like the rest
+                SmallCopyPool pool;
+                pool.verify = job.verify;
+                Transfer::StartPool(pool);
+
+                if (pool.threads_created != 0)
+                    state.pool = std::addressof(pool);
+
+                job.success = Transfer::CopyDir(src_path, dest_path, state);
+                Transfer::StopPool(pool);
+                job.success = (job.success) && (!cancel);
+                state.failed = (state.failed) || (pool.failed);
+            }
+            else if (Transfer::IsCopied(dest_path.c_str(), src_stat)) {
+                struct stat file_stat = { 0 };
+                job.success = true;
+
+                if ((stat(dest_path.c_str(), std::addressof(file_stat)) == 0) && (S_ISDIR(file_stat.st_mode)))
+                    job.type = FsDirEntryType_Dir;
+            }
+            else {
+                job.success = Transfer::CopyFile(src_path.c_str(), dest_path.c_str(), job.name.c_str(), static_cast<u64>(src_stat.st_mtime), state);
+
+                // A split file shows up as a folder of parts
+                if ((job.success) && (state.split))
+                    job.type = FsDirEntryType_Dir;
+            }
+
+            // The journal stays behind for a job that can still be finished by pasting it again
+            Journal::End((cancel)? (!suspend) : ((job.success) && (!state.failed)));
+            
+            {
+                std::scoped_lock lock(finished_mutex);
+                finished.push_back(std::move(job));
+            }
+
+            {
+                std::scoped_lock lock(queue_mutex);
+                running_job = {};
+
+                if (skip) {
+                    skip = false;
+                    cancel = false;
+                    suspend = false;
+                }
+            }
+
+            skip_cond.notify_all();
+        }
+
+        std::free(blocks);
+    }
+
+    // Queues a copy, the thread is started when it isn't already working through the queue.
+    void Add(const TransferJob &job) {
+        PathBuilder dest_path(job.dest_device + job.dest_folder);
+        dest_path.Push(job.name);
+
+        if (job.src_path.compare(dest_path.c_str()) == 0) {
+            Log::Error("Transfer::Add(%s) source and destination are the same.\n", job.src_path.c_str());
+            return;
+        }
+
+        // Copies between a pair of devices start from the block size learned last time
+        if (!tuners_loaded) {
+            std::scoped_lock lock(tuners_mutex);
+
+            for (const auto &[device_pair, block_size] : cfg.copy_block_sizes) {
+                BlockTuner &tuner = tuners[device_pair];
+
+                for (std::size_t i = 0; i < copy_block_sizes_count; i++) {
+                    if (copy_block_sizes[i] <= block_size)
+                        tuner.index = i;
+                }
+            }
+
+            tuners_loaded = true;
+        }
+
+        {
+            std::scoped_lock lock(thread_mutex, queue_mutex);
+            queue.push_back(job);
+
+            // Picked up here, the config is only read on the UI thread
+            queue.back().verify = cfg.verify_copies;
+
+            if (running)
+                return;
+            
+            // It has left the queue behind, it's on its way out if it hasn't exited yet
+            if (thread_created) {
+                threadWaitForExit(std::addressof(thread));
+                threadClose(std::addressof(thread));
+                thread_created = false;
+            }
+
+            running = true;
+            bytes_done = 0;
+            files_done = 0;
+            rate_tick = 0;
+
+            Result ret = 0;
+            if (R_SUCCEEDED(ret = threadCreate(std::addressof(thread), TransferThreadFunc, nullptr, nullptr, 0x10000, 0x2C, -2))) {
+                if (R_SUCCEEDED(ret = threadStart(std::addressof(thread)))) {
+                    thread_created = true;
+                    return;
+                }
+
+                Log::Error("Transfer::Add threadStart() failed: 0x%x\n", ret);
+                threadClose(std::addressof(thread));
+            }
+            else
+                Log::Error("Transfer::Add threadCreate() failed: 0x%x\n", ret);
+        }
+
+        // Without a thread the copy runs here, same as it used to
+        Transfer::TransferThreadFunc(nullptr);
+    }
+
+    // Block sizes learned since the last save go into the config. Only called from the UI thread, and only
+    // once a job is done or we're exiting, as every save rewrites config.json.
+    static void SaveBlockSizes(void) {
+        std::scoped_lock lock(tuners_mutex);
+
+        if (!tuners_changed)
+            return;
+        
+        for (const auto &[device_pair, tuner] : tuners)
+            cfg.copy_block_sizes[device_pair] = static_cast<u32>(copy_block_sizes[tuner.index]);
+        
+        Config::Save(cfg);
+        tuners_changed = false;
+    }
+
+    // Hands out the jobs that are done since the last call.
+    bool Poll(std::vector<TransferJob> &jobs) {
+        {
+            std::scoped_lock lock(finished_mutex);
+
+            if (finished.empty())
+                return false;
+            
+            jobs.insert(jobs.end(), std::make_move_iterator(finished.begin()), std::make_move_iterator(finished.end()));
+            finished.clear();
+        }
+
+        Transfer::SaveBlockSizes();
+        return true;
+    }
+
+    void GetProgress(TransferProgress &progress) {
+        {
+            std::scoped_lock lock(progress_mutex);
+            progress.name = progress_name;
+        }
+
+        {
+            std::scoped_lock lock(queue_mutex);
+            progress.jobs_left = queue.size() + (running? 1 : 0);
+        }
+
+        progress.offset = progress_offset;
+        progress.size = progress_size;
+        progress.job_offset = job_offset;
+        progress.job_size = job_size;
+
+        // The rates are smoothed over a few samples so the readout doesn't jump around with every block
+        const u64 tick = armGetSystemTick(), bytes = bytes_done, files = files_done;
+
+        if (rate_tick == 0) {
+            rate_tick = tick;
+            rate_bytes = bytes;
+            rate_files = files;
+            bytes_rate = 0.0;
+            files_rate = 0.0;
+        }
+        else if (armTicksToNs(tick - rate_tick) >= rate_sample_interval) {
+            const double seconds = static_cast<double>(armTicksToNs(tick - rate_tick)) / 1000000000.0;
+            const double bytes_sample = static_cast<double>(bytes - rate_bytes) / seconds;
+            const double files_sample = static_cast<double>(files - rate_files) / seconds;
+
+            bytes_rate = (bytes_rate == 0.0)? bytes_sample : ((bytes_rate * 0.7) + (bytes_sample * 0.3));
+            files_rate = (files_rate == 0.0)? files_sample : ((files_rate * 0.7) + (files_sample * 0.3));
+            rate_tick = tick;
+            rate_bytes = bytes;
+            rate_files = files;
+        }
+
+        progress.bytes_rate = bytes_rate;
+        progress.files_rate = files_rate;
+        progress.eta = ((bytes_rate > 0.0) && (progress.job_size > progress.job_offset))?
+            static_cast<u64>(static_cast<double>(progress.job_size - progress.job_offset) / bytes_rate) : 0;
+    }
+
+    bool Busy(void) {
+        std::scoped_lock lock(queue_mutex);
+        return running;
+    }
+
+    static void Stop(bool keep) {
+        std::scoped_lock thread_lock(thread_mutex);
+
+        {
+            std::scoped_lock lock(queue_mutex);
+            queue.clear();
+
+            if (!thread_created)
+                return;
+            
+            suspend = keep;
+            cancel = true;
+            skip = false;
+        }
+
+        skip_cond.notify_all();
+
+        threadWaitForExit(std::addressof(thread));
+        threadClose(std::addressof(thread));
+        thread_created = false;
+        cancel = false;
+        suspend = false;
+    }
+
+    // Stops the file being copied and drops everything still queued.
+    void Cancel(void) {
+        Transfer::Stop(false);
+    }
+
+    // Same as a cancel, except the job being copied keeps its journal and what it wrote up to the last
+    // journalled offset, so pasting it again carries on. Jobs that were still queued are dropped.
+    void Suspend(void) {
+        Transfer::Stop(true);
+    }
+
+    static bool UsesDevice(const TransferJob &job, const std::string &device) {
+        return ((job.dest_device == device) || (job.src_path.compare(0, device.length(), device) == 0));
+    }
+
+    // For a drive that's gone. The job being copied is suspended if it reads from or writes to it, and waited
+    // for, queued jobs that do are handed back as failed. Everything else carries on.
+    void SuspendDevice(const std::string &device) {
+        std::unique_lock lock(queue_mutex);
+
+        for (auto job = queue.begin(); job != queue.end();) {
+            if (!Transfer::UsesDevice(*job, device)) {
+                ++job;
+                continue;
+            }
+
+            {
+                std::scoped_lock finished_lock(finished_mutex);
+                finished.push_back(std::move(*job));
+            }
+
+            job = queue.erase(job);
+        }
+
+        if ((!running) || (!Transfer::UsesDevice(running_job, device)))
+            return;
+        
+        skip = true;
+        suspend = true;
+        cancel = true;
+        skip_cond.wait(lock, []() { return (!skip); });
+    }
+
+    // Suspends the copy in progress so it can be picked up next time, and keeps what it learned about block sizes.
+    void Exit(void) {
+        Transfer::Stop(true);
+        Transfer::SaveBlockSizes();
+    }
+}
@@ -1,5 +1,8 @@
+#include <algorithm>
 #include <cstdio>
+#include <cstring>
 
+#include "transfer.hpp"
 #include "usb.hpp"
 #include "usbhsfs.h"
 #include "windows.hpp"
@@ -12,6 +15,30 @@ namespace USB {
     static u32 listed_device_count = 0;
     static bool thread_created = false;
 
+    /* Drives we listed that aren't mounted anymore. */
+    static std::vector<std::string> GetRemovedDevices(void) {
+        std::scoped_lock lock(devices_list_mutex);
+        std::vector<std::string> removed;
+
+        if (!listed_device_count)
+            return removed;
+        
+        std::vector<UsbHsFsDevice> mounted(usbHsFsGetMountedDeviceCount());
+        const u32 mounted_count = mounted.empty()? 0 : usbHsFsListMountedDevices(mounted.data(), mounted.size());
+
+        for(u32 i = 0; i < listed_device_count; i++) {
+            const char *name = usb_devices[i].name;
+            const bool found = std::any_of(mounted.begin(), mounted.begin() + mounted_count, [name](const UsbHsFsDevice &device) {
+                return (std::strcmp(device.name, name) == 0);
+            });
+
+            if (!found)
+                removed.push_back(name);
+        }
+
+        return removed;
+    }
+
     // This function is heavily based off the example provided by DarkMatterCore
     // https://github.com/DarkMatterCore/libusbhsfs/blob/main/example/source/main.c
     static void usbMscThreadFunc(void *arg) {
@@ -33,6 +60,10 @@ namespace USB {
             if (idx == 1)
                 break;
 
+            /* A copy to or from a drive that's gone can't go on, it keeps its journal to be picked up again. */
+            for (const std::string &device : USB::GetRemovedDevices())
+                Transfer::SuspendDevice(device);
+
             /* Free USB Mass Storage device data. */
             USB::Unmount();
 
@@ -113,6 +144,29 @@ namespace USB {
         return (listed_device_count > 0);
     }
 
+    // FAT can't hold a file of 4 GiB or more, 0 means the drive has no limit we need to care about.
+    u64 GetFileSizeLimit(const std::string &device) {
+        std::scoped_lock lock(devices_list_mutex);
+
+        for(u32 i = 0; i < listed_device_count; i++) {
+            UsbHsFsDevice *usb_device = std::addressof(usb_devices[i]);
+            if (device.compare(usb_device->name) != 0)
+                continue;
+            
+            switch (usb_device->fs_type) {
+                case UsbHsFsDeviceFileSystemType_FAT12:
+                case UsbHsFsDeviceFileSystemType_FAT16:
+                case UsbHsFsDeviceFileSystemType_FAT32:
+                    return 0xFFFFFFFF;
+                
+                default:
+                    return 0;
+            }
+        }
+
+        return 0;
+    }
+
     void Unmount(void) {
         std::scoped_lock lock(devices_list_mutex);
 
@@ -2,6 +2,7 @@
 #include <cstring>
 
 #include "config.hpp"
+#include "dirsize.hpp"
 #include "imgui.h"
 #include "popups.hpp"
 #include "tabs.hpp"
@@ -25,27 +26,40 @@ namespace Windows {
     
     void ResetCheckbox(WindowData &data) {
         data.checkbox_data.checked.clear();
-        data.checkbox_data.checked_copy.clear();
-        data.checkbox_data.checked.resize(data.entries.size());
-        data.checkbox_data.checked.assign(data.checkbox_data.checked.size(), false);
         data.checkbox_data.cwd = "";
-        data.checkbox_data.count = 0;
     };
 
-    void MainWindow(WindowData &data, u64 &key, bool progress) {
+    bool IsChecked(const WindowData &data, const DirEntry &entry) {
+        if ((data.checkbox_data.checked.empty()) || (data.checkbox_data.cwd != cwd) || (data.checkbox_data.device != device))
+            return false;
+        
+        return (data.checkbox_data.checked.find(entry.name) != data.checkbox_data.checked.end());
+    }
+
+    void ToggleCheckbox(WindowData &data, const DirEntry &entry) {
+        if ((data.checkbox_data.cwd.length() != 0) && ((data.checkbox_data.cwd != cwd) || (data.checkbox_data.device != device)))
+            Windows::ResetCheckbox(data);
+        
+        data.checkbox_data.cwd = cwd;
+        data.checkbox_data.device = device;
+        
+        auto [checked_entry, inserted] = data.checkbox_data.checked.emplace(entry.name, entry.type);
+        if (!inserted)
+            data.checkbox_data.checked.erase(checked_entry);
+    }
+
+    void MainWindow(WindowData &data, u64 &key) {
         Windows::SetupWindow();
         if (ImGui::Begin("NX-Shell", nullptr, ImGuiWindowFlags_NoMove | ImGuiWindowFlags_NoResize | ImGuiWindowFlags_NoCollapse)) {
             if (ImGui::BeginTabBar("NX-Shell-tabs")) {
                 Tabs::FileBrowser(data);
+                Tabs::Search(data);
                 Tabs::Settings(data);
                 ImGui::EndTabBar();
             }
         }
         Windows::ExitWindow();
 
-        if (progress)
-            return;
-
         switch (data.state) {
             case WINDOW_STATE_OPTIONS:
                 Popups::OptionsPopup(data);
@@ -71,16 +85,9 @@ namespace Windows {
         if ((key & HidNpadButton_X) && (data.state == WINDOW_STATE_FILEBROWSER))
             data.state = WINDOW_STATE_OPTIONS;
 
-        if (key & HidNpadButton_Y) {
-            if ((data.checkbox_data.cwd.length() != 0) && (data.checkbox_data.cwd != cwd))
-                Windows::ResetCheckbox(data);
-            
-            if ((std::strncmp(data.entries[data.selected].name, "..", 2)) != 0) {
-                data.checkbox_data.cwd = cwd;
-                data.checkbox_data.device = device;
-                data.checkbox_data.checked.at(data.selected) = !data.checkbox_data.checked.at(data.selected);
-                data.checkbox_data.count = std::count(data.checkbox_data.checked.begin(), data.checkbox_data.checked.end(), true);
-            }
+        if ((key & HidNpadButton_Y) && (data.selected < data.entries.size())) {
+            if (!(data.entries[data.selected].flags & DirEntryFlagParent))
+                Windows::ToggleCheckbox(data, data.entries[data.selected]);
         }
 
         if (key & HidNpadButton_B) {
@@ -90,6 +97,7 @@ namespace Windows {
                     break;
 
                 case WINDOW_STATE_PROPERTIES:
+                    DirSize::Cancel();
                     data.state = WINDOW_STATE_OPTIONS;
                     file_stat = false;
                     break;